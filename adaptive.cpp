@@ -0,0 +1,391 @@
+#include "headers.h"
+
+namespace
+{
+const size_t BAND_ROWS = 64;
+const size_t EXTRACT_CHUNK = 8 * 4096;
+
+enum AdaptiveKind
+{
+    ADAPTIVE_LSB,
+    ADAPTIVE_QIM,
+    ADAPTIVE_CD
+};
+
+struct AdaptiveMethod
+{
+    AdaptiveKind kind;
+    int param;
+    int divisor; // embedding never changes the cell base of v, see cell_base
+    int bits;    // message bits per slot
+    int top;     // highest QIM cell base that still holds both symbols below 256
+};
+
+AdaptiveMethod parse_method(const std::string &method, int param)
+{
+    if (method == "lsb")
+    {
+        if (param < 1 || param > 4)
+        {
+            throw std::runtime_error("LSB bits per channel must be in range 1..4");
+        }
+        return {ADAPTIVE_LSB, param, 1 << param, param, 0};
+    }
+    if (method == "qim")
+    {
+        if (param < 2)
+        {
+            throw std::runtime_error("QIM step must be at least 2");
+        }
+        return {ADAPTIVE_QIM, param, param, 1, qim_top_base(param)};
+    }
+    if (method == "cd")
+        return {ADAPTIVE_CD, 0, 2, 1, 0};
+    throw std::runtime_error("Adaptive embedding supports only lsb, qim and cd methods, got: " + method);
+}
+
+int color_channels(int channels)
+{
+    return channels == 2 || channels == 4 ? channels - 1 : channels;
+}
+
+// CD picks the channel from stable bits, so the choice survives its own LSB change
+inline size_t stable_cd_target(const unsigned char *px)
+{
+    const int r = px[0] >> 1, g = px[1] >> 1, b = px[2] >> 1;
+    return std::abs(r - g) < std::abs(g - b) ? 2 : 0;
+}
+
+// Byte that carries slot data: the channel itself for LSB and QIM, the CD target inside the pixel
+inline unsigned char &slot_byte(const AdaptiveMethod &m, unsigned char *pixels, size_t pos)
+{
+    return m.kind == ADAPTIVE_CD ? pixels[pos + stable_cd_target(pixels + pos)] : pixels[pos];
+}
+
+inline int slot_value(const AdaptiveMethod &m, const unsigned char *pixels, size_t pos)
+{
+    return m.kind == ADAPTIVE_CD ? pixels[pos + stable_cd_target(pixels + pos)] : pixels[pos];
+}
+
+// Values of a short last QIM cell join the cell below, so writing a symbol never wraps past 255
+inline int cell_base(const AdaptiveMethod &m, int value)
+{
+    if (m.kind == ADAPTIVE_QIM)
+        return std::min(value / m.param * m.param, m.top);
+    return value / m.divisor * m.divisor;
+}
+
+inline unsigned char write_symbol(const AdaptiveMethod &m, int value, unsigned symbol)
+{
+    if (m.kind == ADAPTIVE_QIM)
+        return static_cast<unsigned char>(cell_base(m, value) + (m.param / 2) * symbol);
+    return static_cast<unsigned char>((value & (0xFF << m.bits)) | symbol);
+}
+
+inline unsigned char read_symbol(const AdaptiveMethod &m, int value)
+{
+    if (m.kind == ADAPTIVE_QIM)
+    {
+        const int base = cell_base(m, value);
+        return std::abs(value - base) < std::abs(value - base - m.param / 2) ? 0 : 1;
+    }
+    return static_cast<unsigned char>(value & ((1 << m.bits) - 1));
+}
+
+// Byte position of a slot in the textured runs
+size_t map_position(const AdaptiveMap &map, size_t slot)
+{
+    const size_t r = std::upper_bound(map.starts.begin(), map.starts.end(), slot) - map.starts.begin() - 1;
+    return map.runs[r].first + (slot - map.starts[r]) * map.stride;
+}
+
+// Calls fn(slot, byte position, count) for the pieces of runs covering [begin, begin + count)
+template <class Fn> void map_spans(const AdaptiveMap &map, size_t begin, size_t count, Fn fn)
+{
+    size_t r = std::upper_bound(map.starts.begin(), map.starts.end(), begin) - map.starts.begin() - 1;
+    const size_t end = begin + count;
+    for (size_t slot = begin; slot < end; ++r)
+    {
+        const size_t run_end = std::min(end, map.starts[r] + map.runs[r].length);
+        fn(slot, map.runs[r].first + (slot - map.starts[r]) * map.stride, run_end - slot);
+        slot = run_end;
+    }
+}
+
+// Runs of ones in a mask row; memchr does the scanning in vector width
+void append_runs(const unsigned char *mask, size_t length, size_t offset, std::vector<AdaptiveMap::Run> &runs)
+{
+    const unsigned char *end = mask + length;
+    for (const unsigned char *p = mask; p < end;)
+    {
+        const void *begin = std::memchr(p, 1, end - p);
+        if (!begin)
+            break;
+        const unsigned char *run = static_cast<const unsigned char *>(begin);
+        const void *stop = std::memchr(run, 0, end - run);
+        p = stop ? static_cast<const unsigned char *>(stop) : end;
+        runs.push_back({offset + (run - mask), static_cast<size_t>(p - run)});
+    }
+}
+} // namespace
+
+AdaptiveMap adaptive_map(const unsigned char *pixels, int width, int height, int channels, const std::string &method,
+                         int param, int threshold)
+{
+    const AdaptiveMethod m = parse_method(method, param);
+    if (m.kind == ADAPTIVE_CD && channels < 3)
+    {
+        throw std::runtime_error("CD requires at least 3 channels");
+    }
+
+    PhaseTimer timer(PHASE_ANALYZE);
+    AdaptiveMap map;
+    map.method = method;
+    map.param = param;
+    map.threshold = threshold;
+    map.width = width;
+    map.height = height;
+    map.channels = channels;
+    map.stride = m.kind == ADAPTIVE_CD ? channels : 1;
+    if (width < 3 || height < 3)
+        return map;
+
+    // Power-of-two divisors are masked inside the kernel; QIM cells are reduced to their base first
+    const bool power_of_two = (m.divisor & (m.divisor - 1)) == 0;
+    const unsigned char keep = power_of_two ? static_cast<unsigned char>(~(m.divisor - 1)) : 0xFF;
+    unsigned char stable[256];
+    for (int v = 0; v < 256; ++v)
+        stable[v] = static_cast<unsigned char>(cell_base(m, v));
+
+    const size_t row_bytes = static_cast<size_t>(width) * channels;
+    const bool has_alpha = color_channels(channels) != channels;
+    const size_t bands = (static_cast<size_t>(height) + BAND_ROWS - 1) / BAND_ROWS;
+    std::vector<std::vector<AdaptiveMap::Run>> band_runs(bands);
+
+    parallel_for(bands, [&](size_t band) {
+        const size_t first = std::max<size_t>(band * BAND_ROWS, 1);
+        const size_t last = std::min((band + 1) * BAND_ROWS, static_cast<size_t>(height) - 1);
+        if (first >= last)
+            return;
+
+        // The kernel walks the whole band at once; QIM reduces the band and its two halo rows beforehand
+        const size_t count = last - first;
+        std::vector<unsigned char> reduced, mask(count * row_bytes);
+        const unsigned char *rows = pixels + first * row_bytes;
+        if (!power_of_two)
+        {
+            reduced.resize((count + 2) * row_bytes);
+            const unsigned char *src = pixels + (first - 1) * row_bytes;
+            for (size_t i = 0; i < reduced.size(); ++i)
+                reduced[i] = stable[src[i]];
+            rows = reduced.data() + row_bytes;
+        }
+        texture_mask_rows(rows, row_bytes, count, channels, keep, threshold, mask.data());
+
+        for (size_t y = first; y < last; ++y)
+        {
+            unsigned char *row_mask = &mask[(y - first) * row_bytes];
+            if (m.kind == ADAPTIVE_CD)
+            {
+                // A pixel is a slot when the channel CD would modify is textured
+                const unsigned char *px = pixels + y * row_bytes;
+                for (size_t x = 0; x < static_cast<size_t>(width); ++x)
+                    row_mask[x] = row_mask[x * channels + stable_cd_target(px + x * channels)];
+                append_runs(row_mask, width, y * width, band_runs[band]);
+                continue;
+            }
+            if (has_alpha)
+            {
+                for (size_t i = channels - 1; i < row_bytes; i += channels)
+                    row_mask[i] = 0;
+            }
+            append_runs(row_mask, row_bytes, y * row_bytes, band_runs[band]);
+        }
+    });
+
+    for (const auto &runs : band_runs)
+    {
+        for (const auto &run : runs)
+        {
+            map.starts.push_back(map.total);
+            map.runs.push_back({m.kind == ADAPTIVE_CD ? run.first * channels : run.first, run.length});
+            map.total += run.length;
+        }
+    }
+    stats_add(PIXELS_TOUCHED, row_bytes * height);
+    return map;
+}
+
+size_t adaptive_capacity(const unsigned char *pixels, int width, int height, int channels,
+                         const std::string &method, int param, int threshold)
+{
+    const AdaptiveMap map = adaptive_map(pixels, width, height, channels, method, param, threshold);
+    const size_t bytes = map.total * parse_method(method, param).bits / 8;
+    return bytes > 0 ? bytes - 1 : 0;
+}
+
+void adaptive_embed_pixels(unsigned char *pixels, const AdaptiveMap &map, const std::string &msg,
+                           const std::string &key)
+{
+    const AdaptiveMethod m = parse_method(map.method, map.param);
+    std::vector<unsigned char> symbols;
+    {
+        PhaseTimer timer(PHASE_MESSAGE);
+        symbols = unpack_symbols(msg + '\0', m.bits);
+    }
+    if (symbols.size() > map.total)
+    {
+        throw std::runtime_error("Message too large for the image");
+    }
+
+    PhaseTimer timer(PHASE_EMBED);
+    stats_add(PIXELS_TOUCHED, symbols.size());
+    DistortionMeter meter(static_cast<size_t>(map.width) * map.height * map.channels);
+    ScatterOrder order(map.total, key);
+    if (order.keyed())
+    {
+        for (size_t i = 0; i < symbols.size(); ++i)
+        {
+            unsigned char &target = slot_byte(m, pixels, map_position(map, order.at(i)));
+            const int before = target;
+            target = write_symbol(m, before, symbols[i]);
+            meter.record(before, target);
+        }
+    }
+    else
+    {
+        // LSB and QIM runs are contiguous bytes for the vector kernels; CD picks a channel per pixel
+        map_spans(map, 0, symbols.size(), [&](size_t slot, size_t pos, size_t n) {
+            DistortionMeter *span_meter = meter.enabled() ? &meter : nullptr;
+            if (m.kind == ADAPTIVE_LSB)
+            {
+                lsb_insert_bits(pixels + pos, symbols.data() + slot, n, m.bits, span_meter);
+                return;
+            }
+            if (m.kind == ADAPTIVE_QIM)
+            {
+                qim_insert_bits(pixels + pos, symbols.data() + slot, n, m.param, m.top, span_meter);
+                return;
+            }
+            for (size_t k = 0; k < n; ++k)
+            {
+                unsigned char &target = slot_byte(m, pixels, pos + k * map.stride);
+                const int before = target;
+                target = write_symbol(m, before, symbols[slot + k]);
+                meter.record(before, target);
+            }
+        });
+    }
+
+    // Embedding leaves the stable bits the map was built from untouched, so verification reuses it
+    timer.stop();
+    if (embed_verify_enabled() && adaptive_extract_pixels(pixels, map, key) != msg.substr(0, msg.find('\0')))
+    {
+        throw std::runtime_error("Verification failed: adaptive " + map.method +
+                                 " extraction does not match the message");
+    }
+}
+
+std::string adaptive_extract_pixels(const unsigned char *pixels, const AdaptiveMap &map, const std::string &key)
+{
+    const AdaptiveMethod m = parse_method(map.method, map.param);
+    PhaseTimer timer(PHASE_EXTRACT);
+    ScatterOrder order(map.total, key);
+
+    // Chunk of 8*N symbols always packs into whole bytes, so no bits carry over between chunks
+    std::string message;
+    std::vector<unsigned char> symbols(EXTRACT_CHUNK);
+    for (size_t start = 0; start < map.total; start += EXTRACT_CHUNK)
+    {
+        const size_t n = std::min(EXTRACT_CHUNK, map.total - start);
+        if (order.keyed())
+        {
+            for (size_t i = 0; i < n; ++i)
+                symbols[i] = read_symbol(m, slot_value(m, pixels, map_position(map, order.at(start + i))));
+        }
+        else
+        {
+            map_spans(map, start, n, [&](size_t slot, size_t pos, size_t count) {
+                unsigned char *out = symbols.data() + (slot - start);
+                if (m.kind == ADAPTIVE_LSB)
+                {
+                    lsb_collect_bits(pixels + pos, out, count, m.bits);
+                    return;
+                }
+                if (m.kind == ADAPTIVE_QIM)
+                {
+                    qim_collect_bits(pixels + pos, out, count, m.param, m.top);
+                    return;
+                }
+                for (size_t k = 0; k < count; ++k)
+                    out[k] = read_symbol(m, slot_value(m, pixels, pos + k * map.stride));
+            });
+        }
+
+        stats_add(PIXELS_TOUCHED, n);
+        const std::string bytes = pack_symbols(symbols.data(), n, m.bits);
+        const size_t end = bytes.find('\0');
+        message.append(bytes, 0, end);
+        if (end != std::string::npos)
+            break;
+    }
+    return message;
+}
+
+void adaptive_embed_pixels(unsigned char *pixels, int width, int height, int channels, const std::string &msg,
+                           const std::string &method, int param, int threshold, const std::string &key)
+{
+    adaptive_embed_pixels(pixels, adaptive_map(pixels, width, height, channels, method, param, threshold), msg, key);
+}
+
+std::string adaptive_extract_pixels(const unsigned char *pixels, int width, int height, int channels,
+                                    const std::string &method, int param, int threshold, const std::string &key)
+{
+    return adaptive_extract_pixels(pixels, adaptive_map(pixels, width, height, channels, method, param, threshold),
+                                   key);
+}
+
+size_t adaptive_capacity(const std::string &method, const std::string &image, int param, int threshold)
+{
+    ImageData img;
+    img.data = load_image(image, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    return adaptive_capacity(img.data, img.width, img.height, img.channels, method, param, threshold);
+}
+
+void adaptive_embed(const std::string &method, const std::string &original, const std::string &stego,
+                    const std::string &msg_file, int param, int threshold, const std::string &key)
+{
+    ImageData img;
+    img.data = load_image(original, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    const std::string msg = read_file_to_string(msg_file);
+    adaptive_embed_pixels(img.data, img.width, img.height, img.channels, msg, method, param, threshold, key);
+
+    write_image(stego, img.width, img.height, img.channels, img.data);
+}
+
+void adaptive_extract(const std::string &method, const std::string &stego, const std::string &output_file, int param,
+                      int threshold, const std::string &key)
+{
+    ImageData img;
+    img.data = load_image(stego, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    write_file(output_file,
+               adaptive_extract_pixels(img.data, img.width, img.height, img.channels, method, param, threshold, key));
+}
@@ -0,0 +1,128 @@
+#include "headers.h"
+#include <cstddef>
+#include <new>
+
+// Linked only into stego_program: --stats counts every C++ heap allocation of the process, tests and the
+// benchmark keep the default allocator. The full replaceable set is defined so aligned and nothrow
+// allocations are counted too and every form is released with the matching std::free.
+namespace
+{
+void *counted_alloc(std::size_t size, std::size_t alignment = 0) noexcept
+{
+    stats_add(ALLOCATIONS, 1);
+    stats_add(ALLOCATED_BYTES, size);
+    if (size == 0)
+        size = 1;
+    if (alignment <= alignof(std::max_align_t))
+        return std::malloc(size);
+    // aligned_alloc needs the size to be a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *counted_alloc_or_throw(std::size_t size, std::size_t alignment = 0)
+{
+    if (void *p = counted_alloc(size, alignment))
+        return p;
+    throw std::bad_alloc();
+}
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    return counted_alloc_or_throw(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return counted_alloc_or_throw(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return counted_alloc_or_throw(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return counted_alloc_or_throw(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,251 @@
+#include "headers.h"
+
+namespace
+{
+const int TILE_COUNT = 64;
+
+struct TileStats
+{
+    uint64_t hist[4][256] = {};
+    // Regular/singular group counts for mask M and -M, on the image and on the image with flipped LSBs
+    uint64_t rs[8] = {};
+    uint64_t groups = 0;
+};
+
+// Upper regularized gamma function Q(a, x), Numerical Recipes gser/gcf
+double gamma_q(double a, double x)
+{
+    if (x <= 0)
+        return 1.0;
+    const double gln = std::lgamma(a);
+    if (x < a + 1)
+    {
+        double ap = a, sum = 1.0 / a, del = sum;
+        for (int n = 0; n < 500; ++n)
+        {
+            ap += 1;
+            del *= x / ap;
+            sum += del;
+            if (std::fabs(del) < std::fabs(sum) * 1e-12)
+                break;
+        }
+        return 1.0 - sum * std::exp(-x + a * std::log(x) - gln);
+    }
+    double b = x + 1 - a, c = 1.0 / 1e-300, d = 1.0 / b, h = d;
+    for (int i = 1; i < 500; ++i)
+    {
+        const double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        if (std::fabs(d) < 1e-300)
+            d = 1e-300;
+        c = b + an / c;
+        if (std::fabs(c) < 1e-300)
+            c = 1e-300;
+        d = 1.0 / d;
+        const double del = d * c;
+        h *= del;
+        if (std::fabs(del - 1) < 1e-12)
+            break;
+    }
+    return std::exp(-x + a * std::log(x) - gln) * h;
+}
+
+// Westfeld-Pfitzmann pairs of values test: probability that the pairs 2k/2k+1 were equalized by embedding
+double chi_square_p(const uint64_t *hist)
+{
+    double chi = 0;
+    int categories = 0;
+    for (int k = 0; k < 128; ++k)
+    {
+        const double expected = (hist[2 * k] + hist[2 * k + 1]) / 2.0;
+        if (expected < 5)
+            continue;
+        const double diff = hist[2 * k] - expected;
+        chi += diff * diff / expected;
+        ++categories;
+    }
+    if (categories < 2)
+        return 0;
+    return gamma_q((categories - 1) / 2.0, chi / 2.0);
+}
+
+int discrimination(const int *g)
+{
+    return std::abs(g[1] - g[0]) + std::abs(g[2] - g[1]) + std::abs(g[3] - g[2]);
+}
+
+int flip_positive(int v)
+{
+    return v ^ 1;
+}
+
+int flip_negative(int v)
+{
+    return ((v + 1) ^ 1) - 1;
+}
+
+// Fridrich RS analysis, groups of 4 horizontal samples with mask [0 1 1 0]
+void rs_group(const int *g, uint64_t *rs)
+{
+    for (int flipped = 0; flipped < 2; ++flipped)
+    {
+        int base[4];
+        for (int i = 0; i < 4; ++i)
+            base[i] = flipped ? flip_positive(g[i]) : g[i];
+        const int f0 = discrimination(base);
+
+        int pos[4] = {base[0], flip_positive(base[1]), flip_positive(base[2]), base[3]};
+        int neg[4] = {base[0], flip_negative(base[1]), flip_negative(base[2]), base[3]};
+        const int fp = discrimination(pos), fn = discrimination(neg);
+        uint64_t *out = rs + flipped * 4;
+        out[0] += fp > f0;
+        out[1] += fp < f0;
+        out[2] += fn > f0;
+        out[3] += fn < f0;
+    }
+}
+
+double rs_rate(const uint64_t *rs, uint64_t groups)
+{
+    if (groups == 0)
+        return 0;
+    const double n = static_cast<double>(groups);
+    const double d0 = (rs[0] - static_cast<double>(rs[1])) / n;
+    const double n0 = (rs[2] - static_cast<double>(rs[3])) / n;
+    const double d1 = (rs[4] - static_cast<double>(rs[5])) / n;
+    const double n1 = (rs[6] - static_cast<double>(rs[7])) / n;
+
+    const double a = 2 * (d1 + d0), b = n0 - n1 - d1 - 3 * d0, c = d0 - n0;
+    double z;
+    if (std::fabs(a) < 1e-12)
+    {
+        if (std::fabs(b) < 1e-12)
+            return 0;
+        z = -c / b;
+    }
+    else
+    {
+        const double disc = b * b - 4 * a * c;
+        if (disc < 0)
+            return 0;
+        const double z1 = (-b + std::sqrt(disc)) / (2 * a), z2 = (-b - std::sqrt(disc)) / (2 * a);
+        z = std::fabs(z1) < std::fabs(z2) ? z1 : z2;
+    }
+    if (std::fabs(z - 0.5) < 1e-12)
+        return 1;
+    return std::min(1.0, std::max(0.0, z / (z - 0.5)));
+}
+} // namespace
+
+StegAnalysis analyze_image(const std::string &path, unsigned threads)
+{
+    StegAnalysis result;
+    result.image = path;
+    unsigned char *data = load_image(path, &result.width, &result.height, &result.channels, 0);
+    if (!data)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(data, stbi_image_free);
+
+    PhaseTimer timer(PHASE_ANALYZE);
+    const int width = result.width, height = result.height, channels = result.channels;
+    stats_add(PIXELS_TOUCHED, static_cast<uint64_t>(width) * height * channels);
+    // Alpha is not analyzed: it is usually constant and would mask the colour statistics
+    const int colour = channels >= 3 ? 3 : 1;
+    const int tiles = std::min(TILE_COUNT, std::max(1, height));
+    std::vector<TileStats> stats(tiles);
+
+    parallel_for(tiles, [&](size_t t) {
+        TileStats &tile = stats[t];
+        const int row_begin = static_cast<int>(static_cast<int64_t>(height) * t / tiles);
+        const int row_end = static_cast<int>(static_cast<int64_t>(height) * (t + 1) / tiles);
+        const unsigned char *rows = data + static_cast<size_t>(row_begin) * width * channels;
+        channel_histograms(rows, static_cast<size_t>(row_end - row_begin) * width, channels, tile.hist);
+
+        for (int y = row_begin; y < row_end; ++y)
+        {
+            const unsigned char *row = data + static_cast<size_t>(y) * width * channels;
+            for (int c = 0; c < colour; ++c)
+            {
+                for (int x = 0; x + 4 <= width; x += 4)
+                {
+                    int g[4];
+                    for (int i = 0; i < 4; ++i)
+                        g[i] = row[(x + i) * channels + c];
+                    rs_group(g, tile.rs);
+                    ++tile.groups;
+                }
+            }
+        }
+    }, threads);
+
+    result.histograms.assign(channels, std::vector<uint64_t>(256, 0));
+    uint64_t pooled[256] = {}, rs[8] = {}, groups = 0;
+    bool leading = true;
+    int leading_tiles = 0;
+    for (int t = 0; t < tiles; ++t)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            for (int v = 0; v < 256; ++v)
+            {
+                result.histograms[c][v] += stats[t].hist[c][v];
+                if (c < colour)
+                    pooled[v] += stats[t].hist[c][v];
+            }
+        }
+        for (int i = 0; i < 8; ++i)
+            rs[i] += stats[t].rs[i];
+        groups += stats[t].groups;
+
+        // Sequential embedding keeps the prefix p-value high until the end of the payload
+        if (leading && chi_square_p(pooled) > 0.95)
+            ++leading_tiles;
+        else
+            leading = false;
+    }
+
+    result.chi_square_p = chi_square_p(pooled);
+    result.chi_square_rate = static_cast<double>(leading_tiles) / tiles;
+    result.rs_rate = rs_rate(rs, groups);
+    result.estimated_rate = std::max(result.chi_square_rate, result.rs_rate);
+    return result;
+}
+
+std::vector<StegAnalysis> analyze_images(const std::vector<std::string> &paths, unsigned threads)
+{
+    const std::vector<std::string> images = expand_image_paths(paths);
+    std::vector<StegAnalysis> results(images.size());
+    // One image uses every thread for its tiles, a batch spreads whole images over threads
+    const unsigned tile_threads = images.size() == 1 ? threads : 1;
+    parallel_for(images.size(), [&](size_t i) { results[i] = analyze_image(images[i], tile_threads); }, threads);
+    return results;
+}
+
+std::string analysis_to_json(const StegAnalysis &analysis)
+{
+    std::ostringstream out;
+    out.precision(6);
+    out << std::fixed;
+    std::string escaped;
+    for (char c : analysis.image)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    out << "{\"image\":\"" << escaped << "\",\"width\":" << analysis.width << ",\"height\":" << analysis.height
+        << ",\"channels\":" << analysis.channels << ",\"lsb_histogram\":[";
+    for (size_t c = 0; c < analysis.histograms.size(); ++c)
+    {
+        uint64_t zeros = 0, ones = 0;
+        for (int v = 0; v < 256; ++v)
+            (v & 1 ? ones : zeros) += analysis.histograms[c][v];
+        out << (c ? "," : "") << "[" << zeros << "," << ones << "]";
+    }
+    out << "],\"chi_square_p\":" << analysis.chi_square_p << ",\"chi_square_rate\":" << analysis.chi_square_rate
+        << ",\"rs_rate\":" << analysis.rs_rate << ",\"estimated_rate\":" << analysis.estimated_rate << "}";
+    return out.str();
+}
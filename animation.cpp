@@ -0,0 +1,321 @@
+#include "headers.h"
+
+namespace
+{
+const char PNG_SIGNATURE[8] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1A', '\n'};
+const size_t LENGTH_HEADER_SIZE = 8;
+
+void check_bits(int bits)
+{
+    if (bits < 1 || bits > 4)
+    {
+        throw std::runtime_error("LSB bits per channel must be in range 1..4");
+    }
+}
+
+// Only R, G and B carry data, alpha keeps GIF transparency intact
+size_t frame_capacity(int width, int height, int bits)
+{
+    return static_cast<size_t>(width) * height * 3 * bits / 8;
+}
+
+size_t rgb_slot(size_t i)
+{
+    return i / 3 * 4 + i % 3;
+}
+
+void embed_frame(unsigned char *rgba, const std::string &segment, int bits, DistortionMeter &meter)
+{
+    PhaseTimer timer(PHASE_EMBED);
+    const std::vector<unsigned char> symbols = unpack_symbols(segment, bits);
+    stats_add(PIXELS_TOUCHED, symbols.size());
+    const unsigned char keep = static_cast<unsigned char>(0xFF << bits);
+    for (size_t i = 0; i < symbols.size(); ++i)
+    {
+        unsigned char &value = rgba[rgb_slot(i)];
+        const int before = value;
+        value = static_cast<unsigned char>((value & keep) | symbols[i]);
+        meter.record(before, value);
+    }
+}
+
+std::string extract_frame(const unsigned char *rgba, size_t capacity, int bits)
+{
+    PhaseTimer timer(PHASE_EXTRACT);
+    std::vector<unsigned char> symbols((capacity * 8 + bits - 1) / bits);
+    stats_add(PIXELS_TOUCHED, symbols.size());
+    const unsigned char mask = static_cast<unsigned char>((1u << bits) - 1);
+    for (size_t i = 0; i < symbols.size(); ++i)
+        symbols[i] = static_cast<unsigned char>(rgba[rgb_slot(i)] & mask);
+    return pack_symbols(symbols.data(), symbols.size(), bits).substr(0, capacity);
+}
+
+void append_to_string(void *context, void *data, int size)
+{
+    static_cast<std::string *>(context)->append(static_cast<const char *>(data), size);
+}
+
+void append_chunk(std::string &out, const char *type, const char *data, size_t length)
+{
+    char header[8];
+    put_be32(header, static_cast<uint32_t>(length));
+    std::copy(type, type + 4, header + 4);
+    char crc[4];
+    put_be32(crc, crc32(data, length, crc32(type, 4)));
+    out.append(header, 8);
+    out.append(data, length);
+    out.append(crc, 4);
+}
+
+// APNG: IHDR, acTL, then per frame fcTL + IDAT (first frame) or fdAT (other frames), IEND
+std::string build_apng(const std::vector<std::string> &frames, const std::vector<int> &delays, int width, int height)
+{
+    std::string out(PNG_SIGNATURE, 8);
+    uint32_t sequence = 0;
+    for (size_t f = 0; f < frames.size(); ++f)
+    {
+        const std::string &png = frames[f];
+        std::vector<std::pair<const char *, uint32_t>> idat;
+        for (size_t pos = 8; pos + 12 <= png.size();)
+        {
+            const uint32_t length = get_be32(png.data() + pos);
+            const char *type = png.data() + pos + 4;
+            const char *data = png.data() + pos + 8;
+            pos += 12 + static_cast<size_t>(length);
+
+            if (f == 0 && std::equal(type, type + 4, "IHDR"))
+            {
+                append_chunk(out, "IHDR", data, length);
+                char actl[8];
+                put_be32(actl, static_cast<uint32_t>(frames.size()));
+                put_be32(actl + 4, 0);
+                append_chunk(out, "acTL", actl, 8);
+            }
+            else if (std::equal(type, type + 4, "IDAT"))
+            {
+                idat.emplace_back(data, length);
+            }
+        }
+
+        char fctl[26] = {};
+        put_be32(fctl, sequence++);
+        put_be32(fctl + 4, static_cast<uint32_t>(width));
+        put_be32(fctl + 8, static_cast<uint32_t>(height));
+        const int delay = f < delays.size() ? std::max(0, std::min(delays[f], 0xFFFF)) : 100;
+        fctl[20] = static_cast<char>(delay >> 8);
+        fctl[21] = static_cast<char>(delay & 0xFF);
+        fctl[22] = static_cast<char>(1000 >> 8);
+        fctl[23] = static_cast<char>(1000 & 0xFF);
+        append_chunk(out, "fcTL", fctl, sizeof(fctl));
+
+        for (const auto &chunk : idat)
+        {
+            if (f == 0)
+            {
+                append_chunk(out, "IDAT", chunk.first, chunk.second);
+                continue;
+            }
+            std::string fdat(4, '\0');
+            put_be32(&fdat[0], sequence++);
+            fdat.append(chunk.first, chunk.second);
+            append_chunk(out, "fdAT", fdat.data(), fdat.size());
+        }
+    }
+    append_chunk(out, "IEND", "", 0);
+    return out;
+}
+
+// Every frame of APNG is rebuilt as standalone PNG so stb can decode frames independently
+std::vector<std::string> split_apng(const std::string &apng)
+{
+    if (apng.size() < 8 || !std::equal(PNG_SIGNATURE, PNG_SIGNATURE + 8, apng.data()))
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+
+    std::string ihdr;
+    std::vector<std::string> frame_data;
+    bool frame_open = false;
+    for (size_t pos = 8; pos + 12 <= apng.size();)
+    {
+        const uint32_t length = get_be32(apng.data() + pos);
+        const char *type = apng.data() + pos + 4;
+        const char *data = apng.data() + pos + 8;
+        if (pos + 12 + static_cast<size_t>(length) > apng.size())
+        {
+            throw std::runtime_error("Animated image is truncated");
+        }
+        pos += 12 + static_cast<size_t>(length);
+
+        if (std::equal(type, type + 4, "IHDR"))
+        {
+            ihdr.assign(data, length);
+        }
+        else if (std::equal(type, type + 4, "fcTL"))
+        {
+            if (ihdr.size() < 8)
+            {
+                throw std::runtime_error("Animated image has frame control before IHDR");
+            }
+            if (length < 26 || get_be32(data + 4) != get_be32(ihdr.data()) ||
+                get_be32(data + 8) != get_be32(ihdr.data() + 4) || get_be32(data + 12) != 0 || get_be32(data + 16) != 0)
+            {
+                throw std::runtime_error("Only full-canvas animation frames are supported");
+            }
+            frame_data.emplace_back();
+            frame_open = true;
+        }
+        else if (std::equal(type, type + 4, "IDAT"))
+        {
+            if (!frame_open)
+            {
+                frame_data.emplace_back();
+                frame_open = true;
+            }
+            frame_data.back().append(data, length);
+        }
+        else if (std::equal(type, type + 4, "fdAT") && frame_open && length >= 4)
+        {
+            frame_data.back().append(data + 4, length - 4);
+        }
+        else if (std::equal(type, type + 4, "IEND"))
+        {
+            break;
+        }
+    }
+    if (ihdr.size() < 8 || frame_data.empty())
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+
+    std::vector<std::string> frames;
+    for (const auto &data : frame_data)
+    {
+        std::string png(PNG_SIGNATURE, 8);
+        append_chunk(png, "IHDR", ihdr.data(), ihdr.size());
+        append_chunk(png, "IDAT", data.data(), data.size());
+        append_chunk(png, "IEND", "", 0);
+        frames.push_back(png);
+    }
+    return frames;
+}
+} // namespace
+
+size_t gif_capacity(const std::string &image, int bits)
+{
+    check_bits(bits);
+    const std::string gif = read_file_to_string(image);
+    int *delays = nullptr;
+    int width, height, frames, channels;
+    unsigned char *pixels = stbi_load_gif_from_memory(reinterpret_cast<const stbi_uc *>(gif.data()),
+                                                      static_cast<int>(gif.size()), &delays, &width, &height, &frames,
+                                                      &channels, 4);
+    if (!pixels)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    stbi_image_free(pixels);
+    stbi_image_free(delays);
+
+    const size_t total = frame_capacity(width, height, bits) * frames;
+    return total > LENGTH_HEADER_SIZE ? total - LENGTH_HEADER_SIZE : 0;
+}
+
+void gif_embed(const std::string &original, const std::string &stego, const std::string &msg_file, int bits)
+{
+    check_bits(bits);
+    const std::string gif = read_file_to_string(original);
+    int *delays = nullptr;
+    int width, height, frames, channels;
+    unsigned char *pixels;
+    {
+        PhaseTimer timer(PHASE_DECODE);
+        pixels = stbi_load_gif_from_memory(reinterpret_cast<const stbi_uc *>(gif.data()), static_cast<int>(gif.size()),
+                                           &delays, &width, &height, &frames, &channels, 4);
+    }
+    if (!pixels)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> pixels_guard(pixels, stbi_image_free);
+    std::unique_ptr<int, void (*)(void *)> delays_guard(delays, stbi_image_free);
+
+    const std::string msg = read_file_to_string(msg_file);
+    std::string stream(LENGTH_HEADER_SIZE, '\0');
+    for (size_t i = 0; i < LENGTH_HEADER_SIZE; ++i)
+        stream[i] = static_cast<char>((static_cast<uint64_t>(msg.size()) >> (8 * i)) & 0xFF);
+    stream += msg;
+
+    const size_t capacity = frame_capacity(width, height, bits);
+    if (stream.size() > capacity * frames)
+    {
+        throw std::runtime_error("Message too large for the image");
+    }
+
+    const size_t frame_bytes = static_cast<size_t>(width) * height * 4;
+    std::vector<std::string> encoded(frames);
+    parallel_for(frames, [&](size_t f) {
+        unsigned char *frame = pixels + f * frame_bytes;
+        const size_t begin = f * capacity;
+        DistortionMeter meter(static_cast<size_t>(width) * height * 3);
+        if (begin < stream.size())
+        {
+            const std::string segment = stream.substr(begin, capacity);
+            embed_frame(frame, segment, bits, meter);
+            if (embed_verify_enabled() && extract_frame(frame, segment.size(), bits) != segment)
+            {
+                throw std::runtime_error("Verification failed: frame " + std::to_string(f) +
+                                         " extraction does not match the message");
+            }
+        }
+        PhaseTimer timer(PHASE_ENCODE);
+        if (!stbi_write_png_to_func(append_to_string, &encoded[f], width, height, 4, frame, width * 4))
+        {
+            throw std::runtime_error("Failed to encode frame " + std::to_string(f));
+        }
+    });
+
+    std::vector<int> frame_delays;
+    if (delays)
+        frame_delays.assign(delays, delays + frames);
+    write_file(stego, build_apng(encoded, frame_delays, width, height));
+}
+
+void gif_extract(const std::string &stego, const std::string &output_file, int bits)
+{
+    check_bits(bits);
+    const std::vector<std::string> frames = split_apng(read_file_to_string(stego));
+
+    std::vector<std::string> parts(frames.size());
+    parallel_for(frames.size(), [&](size_t f) {
+        int width, height, channels;
+        unsigned char *rgba;
+        {
+            PhaseTimer timer(PHASE_DECODE);
+            rgba = stbi_load_from_memory(reinterpret_cast<const stbi_uc *>(frames[f].data()),
+                                         static_cast<int>(frames[f].size()), &width, &height, &channels, 4);
+        }
+        if (!rgba)
+        {
+            throw std::runtime_error("Failed to load image");
+        }
+        parts[f] = extract_frame(rgba, frame_capacity(width, height, bits), bits);
+        stbi_image_free(rgba);
+    });
+
+    std::string stream;
+    for (const auto &part : parts)
+        stream += part;
+    if (stream.size() < LENGTH_HEADER_SIZE)
+    {
+        throw std::runtime_error("Animated image holds no message");
+    }
+    uint64_t length = 0;
+    for (size_t i = 0; i < LENGTH_HEADER_SIZE; ++i)
+        length |= static_cast<uint64_t>(static_cast<unsigned char>(stream[i])) << (8 * i);
+    if (length > stream.size() - LENGTH_HEADER_SIZE)
+    {
+        throw std::runtime_error("Animated image holds no message");
+    }
+    write_file(output_file, stream.substr(LENGTH_HEADER_SIZE, length));
+}
@@ -0,0 +1,421 @@
+#include "headers.h"
+#include <array>
+
+namespace
+{
+const char AUTO_MAGIC[4] = {'S', 'A', 'U', 'T'};
+const size_t AUTO_HEADER_SIZE = 14; // magic, method, param, length, CRC-32
+
+enum AutoMethodId
+{
+    AUTO_LSB = 1,
+    AUTO_QIM,
+    AUTO_CD,
+    AUTO_CS,
+    AUTO_MBC
+};
+
+const int AUTO_QIM_STEP = 4;
+
+// perf_baseline.json of the source tree, embedded by the build as a raw string literal
+const char BUILTIN_BASELINE[] =
+#include "perf_baseline.inc"
+    ;
+
+// Benchmark rows the model reads: LSB has a row per bit depth, QIM is only chosen with AUTO_QIM_STEP
+struct ModelEntry
+{
+    AutoMethodId id;
+    int param;
+    const char *bench_name;
+};
+
+const ModelEntry MODEL_ENTRIES[] = {{AUTO_LSB, 1, "lsb"},
+                                    {AUTO_LSB, 2, "lsb b=2"},
+                                    {AUTO_LSB, 3, "lsb b=3"},
+                                    {AUTO_LSB, 4, "lsb b=4"},
+                                    {AUTO_QIM, AUTO_QIM_STEP, "qim q=4"},
+                                    {AUTO_CD, 0, "cd"},
+                                    {AUTO_CS, 0, "cs"},
+                                    {AUTO_MBC, 0, "mbc"}};
+
+// Relative round-trip throughput of every MODEL_ENTRIES row
+typedef std::array<double, sizeof(MODEL_ENTRIES) / sizeof(MODEL_ENTRIES[0])> ThroughputModel;
+
+// Model file is written by stego_bench --update, so a key lookup is enough instead of a JSON parser
+ThroughputModel parse_model(const std::string &json, const std::string &source)
+{
+    ThroughputModel relative = {};
+    for (size_t i = 0; i < relative.size(); ++i)
+    {
+        const std::string name = MODEL_ENTRIES[i].bench_name;
+        const size_t key = json.find("\"" + name + "\": {");
+        const size_t value = key == std::string::npos ? key : json.find("\"relative\": ", key);
+        if (value == std::string::npos)
+        {
+            throw std::runtime_error("Throughput model " + source + " has no entry for " + name);
+        }
+        relative[i] = std::stod(json.substr(value + 12));
+    }
+    return relative;
+}
+
+// Parsed on first use, so a baseline without a needed row fails the auto command, not every program at startup
+const ThroughputModel &builtin_model()
+{
+    static const ThroughputModel model = parse_model(BUILTIN_BASELINE, "perf_baseline.json");
+    return model;
+}
+
+// Zero for a method and parameter the benchmark does not cover, so the candidate is skipped
+double model_relative(const ThroughputModel &relative, int id, int param)
+{
+    for (size_t i = 0; i < relative.size(); ++i)
+    {
+        if (MODEL_ENTRIES[i].id == id && MODEL_ENTRIES[i].param == param)
+            return relative[i];
+    }
+    return 0;
+}
+
+std::mutex model_mutex;
+bool model_loaded = false; // set by auto_model_load with a file, otherwise the built-in model is used
+ThroughputModel loaded_model = {};
+
+std::string method_name(int id)
+{
+    switch (id)
+    {
+    case AUTO_LSB:
+        return "lsb";
+    case AUTO_QIM:
+        return "qim";
+    case AUTO_CD:
+        return "cd";
+    case AUTO_CS:
+        return "cs";
+    case AUTO_MBC:
+        return "mbc";
+    }
+    return "unknown";
+}
+
+// Pixels in front of the method's region, the header takes one LSB per channel byte
+size_t header_pixels(int channels)
+{
+    return (AUTO_HEADER_SIZE * 8 + channels - 1) / channels;
+}
+
+void write_header(unsigned char *pixels, const AutoChoice &choice, const std::string &msg)
+{
+    std::string header(AUTO_MAGIC, 4);
+    header += static_cast<char>(choice.id);
+    header += static_cast<char>(choice.param);
+    char word[4];
+    put_be32(word, static_cast<uint32_t>(msg.size()));
+    header.append(word, 4);
+    put_be32(word, crc32(msg.data(), msg.size()));
+    header.append(word, 4);
+    const std::vector<unsigned char> symbols = unpack_symbols(header, 1);
+    lsb_insert_bits(pixels, symbols.data(), symbols.size(), 1);
+}
+
+// Capacity of the method's region in bytes, zero when the method cannot use this carrier
+size_t region_capacity(int id, int param, size_t pixel_count, int channels)
+{
+    switch (id)
+    {
+    case AUTO_LSB:
+        return lsb_capacity_pixels(pixel_count * channels, param);
+    case AUTO_QIM:
+        return qim_capacity_pixels(pixel_count * channels);
+    case AUTO_CD:
+        return channels >= 3 ? cd_capacity_pixels(pixel_count) : 0;
+    case AUTO_CS:
+        return channels == 3 ? ChannelSwapping::capacity_pixels(pixel_count) : 0;
+    case AUTO_MBC:
+        return channels == 3 ? MidBitChange::capacity_pixels(pixel_count) : 0;
+    }
+    return 0;
+}
+
+void embed_region(const AutoChoice &choice, unsigned char *pixels, size_t pixel_count, int channels,
+                  const std::string &msg, const std::string &key)
+{
+    switch (choice.id)
+    {
+    case AUTO_LSB:
+        lsb_embed_pixels(pixels, pixel_count * channels, msg, key, choice.param);
+        break;
+    case AUTO_QIM:
+        qim_embed_pixels(pixels, pixel_count * channels, msg, choice.param, key);
+        break;
+    case AUTO_CD:
+        cd_embed_pixels(pixels, pixel_count, channels, msg, key);
+        break;
+    case AUTO_CS:
+        ChannelSwapping(key).embed(pixels, pixel_count, msg);
+        break;
+    case AUTO_MBC:
+        MidBitChange(key).embed(pixels, pixel_count, msg);
+        break;
+    }
+}
+
+std::string extract_region(int id, int param, const unsigned char *pixels, size_t pixel_count, int channels,
+                           size_t size, const std::string &key)
+{
+    switch (id)
+    {
+    case AUTO_LSB:
+        if (param < 1 || param > 4)
+            break;
+        return lsb_extract_pixels(pixels, pixel_count * channels, key, param);
+    case AUTO_QIM:
+        if (param < 2)
+            break;
+        return qim_extract_pixels(pixels, pixel_count * channels, param, key);
+    case AUTO_CD:
+        if (channels < 3)
+            break;
+        return cd_extract_pixels(pixels, pixel_count, channels, key);
+    case AUTO_CS:
+        if (channels != 3 || size > ChannelSwapping::capacity_pixels(pixel_count))
+            break;
+        return ChannelSwapping(key).extract(pixels, pixel_count, size);
+    case AUTO_MBC:
+        if (channels != 3 || size > MidBitChange::capacity_pixels(pixel_count))
+            break;
+        return MidBitChange(key).extract(pixels, pixel_count, size);
+    }
+    throw std::runtime_error("Error AUTO_HEADER_IS_DAMAGED: Header names method " + std::to_string(id) +
+                             " with parameter " + std::to_string(param) + " that does not fit the carrier");
+}
+
+DistortionTotals compare(const unsigned char *original, const unsigned char *stego, size_t count)
+{
+    DistortionTotals totals;
+    totals.samples = count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const int d = std::abs(original[i] - stego[i]);
+        totals.sse += static_cast<uint64_t>(d * d);
+        totals.changed += d != 0;
+        totals.max_delta = std::max<unsigned>(totals.max_delta, d);
+    }
+    return totals;
+}
+
+// Trial embeds must not count towards --distortion totals or run --verify, auto reads every trial back itself
+class TrialScope
+{
+public:
+    TrialScope() : distortion(distortion_enabled()), verify(embed_verify_enabled())
+    {
+        distortion_enable(false);
+        embed_verify_enable(false);
+    }
+
+    ~TrialScope()
+    {
+        distortion_enable(distortion);
+        embed_verify_enable(verify);
+    }
+
+private:
+    bool distortion;
+    bool verify;
+};
+} // namespace
+
+void auto_model_load(const std::string &path)
+{
+    if (path.empty())
+    {
+        std::lock_guard<std::mutex> lock(model_mutex);
+        model_loaded = false;
+        return;
+    }
+    const ThroughputModel relative = parse_model(read_file_to_string(path), path);
+    std::lock_guard<std::mutex> lock(model_mutex);
+    loaded_model = relative;
+    model_loaded = true;
+}
+
+std::vector<AutoChoice> auto_candidates(int width, int height, int channels, const std::string &msg, int bits)
+{
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    const size_t reserved = header_pixels(channels);
+    if (pixel_count <= reserved)
+        return {};
+    const size_t region = pixel_count - reserved;
+    const size_t carrier_bytes = pixel_count * channels;
+    const bool has_zero = msg.find('\0') != std::string::npos;
+
+    ThroughputModel relative;
+    {
+        std::lock_guard<std::mutex> lock(model_mutex);
+        relative = model_loaded ? loaded_model : builtin_model();
+    }
+
+    std::vector<AutoChoice> candidates;
+    const AutoChoice all[] = {{AUTO_LSB, bits, 0, 0}, {AUTO_QIM, AUTO_QIM_STEP, 0, 0}, {AUTO_CD, 0, 0, 0},
+                              {AUTO_CS, 0, 0, 0},     {AUTO_MBC, 0, 0, 0}};
+    for (AutoChoice choice : all)
+    {
+        // LSB, QIM and CD stop at the first zero byte, so only CS and MBC carry binary payloads
+        const bool terminated = choice.id == AUTO_LSB || choice.id == AUTO_QIM || choice.id == AUTO_CD;
+        const size_t capacity = region_capacity(choice.id, choice.param, region, channels);
+        const double speed = model_relative(relative, choice.id, choice.param);
+        if (capacity < msg.size() || (terminated && has_zero) || speed <= 0)
+            continue;
+        // Benchmarks fill the carrier, so a payload costs its share of capacity times a full pass
+        choice.cost = (static_cast<double>(msg.size()) + 1) / capacity * carrier_bytes / speed;
+        candidates.push_back(choice);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const AutoChoice &a, const AutoChoice &b) { return a.cost < b.cost; });
+    return candidates;
+}
+
+std::string auto_choice_name(const AutoChoice &choice)
+{
+    const std::string name = method_name(choice.id);
+    return choice.id == AUTO_LSB || choice.id == AUTO_QIM ? name + " " + std::to_string(choice.param) : name;
+}
+
+namespace
+{
+bool round_trips(const unsigned char *pixels, int width, int height, int channels, const std::string &msg,
+                 const std::string &key)
+{
+    try
+    {
+        return auto_extract_pixels(pixels, width, height, channels, key) == msg;
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+}
+} // namespace
+
+AutoChoice auto_embed_pixels(unsigned char *pixels, int width, int height, int channels, const std::string &msg,
+                             double min_psnr, const std::string &key, int bits)
+{
+    if (bits < 1 || bits > 4)
+    {
+        throw std::runtime_error("LSB bits per channel must be in range 1..4");
+    }
+    if (msg.size() > 0xFFFFFFFFu)
+    {
+        throw std::runtime_error("Message too large for the image");
+    }
+    const std::vector<AutoChoice> candidates = auto_candidates(width, height, channels, msg, bits);
+    if (candidates.empty())
+    {
+        throw std::runtime_error("Message too large for the image");
+    }
+
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    const size_t reserved = header_pixels(channels);
+    const size_t count = pixel_count * channels;
+    DistortionMeter meter(count);
+    std::vector<unsigned char> trial(count);
+    {
+        // CD and CS do not round-trip on every carrier, so each candidate is embedded into a copy and read back
+        TrialScope scope;
+        for (AutoChoice candidate : candidates)
+        {
+            std::copy(pixels, pixels + count, trial.begin());
+            write_header(trial.data(), candidate, msg);
+            embed_region(candidate, trial.data() + reserved * channels, pixel_count - reserved, channels, msg, key);
+            if (min_psnr > 0)
+            {
+                candidate.psnr = distortion_psnr(compare(pixels, trial.data(), count));
+                if (candidate.psnr < min_psnr)
+                    continue;
+            }
+            if (!round_trips(trial.data(), width, height, channels, msg, key))
+                continue;
+
+            if (meter.enabled())
+            {
+                const DistortionTotals totals = compare(pixels, trial.data(), count);
+                meter.add(totals.sse, totals.changed, totals.max_delta);
+            }
+            std::copy(trial.begin(), trial.end(), pixels);
+            return candidate;
+        }
+    }
+    if (min_psnr > 0)
+    {
+        char bound[32];
+        std::snprintf(bound, sizeof(bound), "%.2f", min_psnr);
+        throw std::runtime_error("No method fits the message within PSNR " + std::string(bound) + " dB");
+    }
+    throw std::runtime_error("No method round-trips the message in this carrier");
+}
+
+std::string auto_extract_pixels(const unsigned char *pixels, int width, int height, int channels,
+                                const std::string &key)
+{
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    const size_t reserved = header_pixels(channels);
+    if (pixel_count <= reserved)
+    {
+        throw std::runtime_error("Error AUTO_HEADER_NOT_FOUND: Carrier is too small for an auto header");
+    }
+
+    std::vector<unsigned char> symbols(AUTO_HEADER_SIZE * 8);
+    lsb_collect_bits(pixels, symbols.data(), symbols.size(), 1);
+    const std::string header = pack_symbols(symbols.data(), symbols.size(), 1);
+    if (!std::equal(AUTO_MAGIC, AUTO_MAGIC + 4, header.begin()))
+    {
+        throw std::runtime_error("Error AUTO_HEADER_NOT_FOUND: Carrier has no auto header");
+    }
+    const int id = static_cast<unsigned char>(header[4]);
+    const int param = static_cast<unsigned char>(header[5]);
+    const size_t size = get_be32(header.data() + 6);
+    const uint32_t crc = get_be32(header.data() + 10);
+
+    std::string msg = extract_region(id, param, pixels + reserved * channels, pixel_count - reserved, channels, size,
+                                     key);
+    if (msg.size() != size || crc32(msg.data(), msg.size()) != crc)
+    {
+        throw std::runtime_error("Error AUTO_CHECKSUM_MISMATCH: Message extracted with " + method_name(id) +
+                                 " is damaged");
+    }
+    return msg;
+}
+
+AutoChoice auto_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
+                      double min_psnr, const std::string &key, int bits)
+{
+    ImageData img;
+    img.data = load_image(original, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    const std::string msg = read_file_to_string(msg_file);
+    const AutoChoice choice = auto_embed_pixels(img.data, img.width, img.height, img.channels, msg, min_psnr, key, bits);
+
+    write_image(stego, img.width, img.height, img.channels, img.data);
+    return choice;
+}
+
+void auto_extract(const std::string &stego, const std::string &output_file, const std::string &key)
+{
+    ImageData img;
+    img.data = load_image(stego, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    write_file(output_file, auto_extract_pixels(img.data, img.width, img.height, img.channels, key));
+}
@@ -0,0 +1,589 @@
+#include "headers.h"
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <unistd.h>
+/**
+ * \file bench.cpp
+ * \brief Микробенчмарк методов стеганографии по стадиям на синтетических изображениях
+ */
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct ImageSize
+{
+    const char *name;
+    int width;
+    int height;
+};
+
+const ImageSize SIZES[] = {
+    {"thumb", 160, 120}, {"vga", 640, 480}, {"fhd", 1920, 1080}, {"12mp", 4000, 3000}, {"100mp", 10000, 10000},
+};
+
+struct Options
+{
+    double max_mp = 100;
+    double min_time = 0.2;
+    bool scaling = true;
+    std::string check_baseline;
+    std::string update_baseline;
+    double tolerance = 0.5;
+};
+
+struct SyntheticImage
+{
+    std::string name;
+    std::string content;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels; // RGB
+    std::string png;
+};
+
+uint32_t next_random(uint32_t &state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+// Noise is the worst case for PNG filters and zlib; photo-like content has smooth gradients, soft texture and edges
+std::vector<unsigned char> make_pixels(int width, int height, bool photo, uint32_t seed)
+{
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+    uint32_t state = seed;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char *px = &pixels[(static_cast<size_t>(y) * width + x) * 3];
+            if (!photo)
+            {
+                const uint32_t r = next_random(state);
+                px[0] = static_cast<unsigned char>(r >> 8);
+                px[1] = static_cast<unsigned char>(r >> 16);
+                px[2] = static_cast<unsigned char>(r >> 24);
+                continue;
+            }
+            const double fx = static_cast<double>(x) / width, fy = static_cast<double>(y) / height;
+            const double shade = 0.5 + 0.3 * std::sin(fx * 7.0 + fy * 3.0) * std::cos(fy * 5.0);
+            const bool block = (static_cast<int>(fx * 6) + static_cast<int>(fy * 4)) % 5 == 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                const int noise = static_cast<int>(next_random(state) >> 29) - 4;
+                const double tint = block ? 0.25 + 0.1 * c : shade * (0.8 + 0.15 * c);
+                px[c] = static_cast<unsigned char>(std::max(0, std::min(255, static_cast<int>(tint * 255) + noise)));
+            }
+        }
+    }
+    return pixels;
+}
+
+void append_to_string(void *context, void *data, int size)
+{
+    static_cast<std::string *>(context)->append(static_cast<const char *>(data), size);
+}
+
+std::string encode_png(const unsigned char *pixels, int width, int height, int channels)
+{
+    std::string png;
+    if (!stbi_write_png_to_func(append_to_string, &png, width, height, channels, pixels, width * channels))
+    {
+        throw std::runtime_error("Failed to encode image");
+    }
+    return png;
+}
+
+// Same path as load_image: the built-in decoder first, stb_image for formats it does not handle
+unsigned char *decode_png(const std::string &png, int *width, int *height)
+{
+    int channels;
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(png.data());
+    if (unsigned char *pixels = png_decode(data, png.size(), width, height, &channels, 3))
+        return pixels;
+    return stbi_load_from_memory(data, static_cast<int>(png.size()), width, height, &channels, 3);
+}
+
+// Payload bytes are never zero, so terminated methods (LSB, QIM, CD) read the whole message back
+std::string make_payload(size_t size, uint32_t seed)
+{
+    std::string payload(size, '\0');
+    uint32_t state = seed;
+    for (auto &c : payload)
+        c = static_cast<char>(1 + next_random(state) % 255);
+    return payload;
+}
+
+// Best time of repeated runs; setup (copying the carrier) is outside of the measured region
+double measure(const std::function<void()> &setup, const std::function<void()> &body, double min_time)
+{
+    double best = 1e300, total = 0;
+    do
+    {
+        setup();
+        const auto start = Clock::now();
+        body();
+        const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        best = std::min(best, elapsed);
+        total += elapsed;
+    } while (total < min_time);
+    return best;
+}
+
+struct Method
+{
+    std::string name;
+    size_t capacity; // bytes for the synthetic carrier
+    std::function<void(unsigned char *, const std::string &)> embed;
+    std::function<std::string(const unsigned char *, size_t)> extract;
+};
+
+// Texture map of the last adaptive embedding; per thread, since the scaling run embeds concurrently
+AdaptiveMap &adaptive_bench_map()
+{
+    thread_local AdaptiveMap map;
+    return map;
+}
+
+std::vector<Method> pixel_methods(int width, int height)
+{
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    const size_t bytes = pixel_count * 3;
+    std::vector<Method> methods;
+    methods.push_back({"lsb", lsb_capacity_pixels(bytes),
+                       [bytes](unsigned char *px, const std::string &msg) { lsb_embed_pixels(px, bytes, msg); },
+                       [bytes](const unsigned char *px, size_t) { return lsb_extract_pixels(px, bytes); }});
+    // Deeper LSB packs symbols differently, so auto selection gets a row per bit depth
+    for (int bits : {2, 3, 4})
+    {
+        methods.push_back({"lsb b=" + std::to_string(bits), lsb_capacity_pixels(bytes, bits),
+                           [bytes, bits](unsigned char *px, const std::string &msg) {
+                               lsb_embed_pixels(px, bytes, msg, "", bits);
+                           },
+                           [bytes, bits](const unsigned char *px, size_t) {
+                               return lsb_extract_pixels(px, bytes, "", bits);
+                           }});
+    }
+    // Threshold 0 keeps every interior pixel, so the row measures the texture map on top of LSB. Extraction
+    // reuses the map of the embedding analysis pass, as in a pipeline that embeds and reads back at once
+    methods.push_back({"lsb adapt", lsb_capacity_pixels(static_cast<size_t>(width - 2) * (height - 2) * 3),
+                       [width, height](unsigned char *px, const std::string &msg) {
+                           AdaptiveMap &map = adaptive_bench_map();
+                           map = adaptive_map(px, width, height, 3, "lsb", 1, 0);
+                           adaptive_embed_pixels(px, map, msg);
+                       },
+                       [](const unsigned char *px, size_t) {
+                           return adaptive_extract_pixels(px, adaptive_bench_map());
+                       }});
+    for (int q : {4, 8, 16})
+    {
+        methods.push_back({"qim q=" + std::to_string(q), qim_capacity_pixels(bytes),
+                           [bytes, q](unsigned char *px, const std::string &msg) {
+                               qim_embed_pixels(px, bytes, msg, q);
+                           },
+                           [bytes, q](const unsigned char *px, size_t) {
+                               return qim_extract_pixels(px, bytes, q);
+                           }});
+    }
+    methods.push_back({"cd", cd_capacity_pixels(pixel_count),
+                       [pixel_count](unsigned char *px, const std::string &msg) {
+                           cd_embed_pixels(px, pixel_count, 3, msg);
+                       },
+                       [pixel_count](const unsigned char *px, size_t) {
+                           return cd_extract_pixels(px, pixel_count, 3);
+                       }});
+    methods.push_back({"cs", ChannelSwapping::capacity_pixels(pixel_count),
+                       [pixel_count](unsigned char *px, const std::string &msg) {
+                           ChannelSwapping().embed(px, pixel_count, msg);
+                       },
+                       [pixel_count](const unsigned char *px, size_t size) {
+                           return ChannelSwapping().extract(px, pixel_count, size);
+                       }});
+    methods.push_back({"mbc", MidBitChange::capacity_pixels(pixel_count),
+                       [pixel_count](unsigned char *px, const std::string &msg) {
+                           MidBitChange().embed(px, pixel_count, msg);
+                       },
+                       [pixel_count](const unsigned char *px, size_t size) {
+                           return MidBitChange().extract(px, pixel_count, size);
+                       }});
+    return methods;
+}
+
+void print_header()
+{
+    printf("%-7s %-6s %-9s %-8s %12s %12s %10s\n", "image", "content", "method", "stage", "MB/s", "ns/pixel",
+           "ms");
+}
+
+void print_stage(const SyntheticImage &image, const std::string &method, const char *stage, double seconds,
+                 double bytes)
+{
+    const double pixels = static_cast<double>(image.width) * image.height;
+    printf("%-7s %-6s %-9s %-8s %12.1f %12.3f %10.3f\n", image.name.c_str(), image.content.c_str(), method.c_str(),
+           stage, bytes / seconds / 1e6, seconds * 1e9 / pixels, seconds * 1e3);
+}
+
+void bench_image(const SyntheticImage &image, const Options &options)
+{
+    const double raw_bytes = static_cast<double>(image.pixels.size());
+    std::vector<unsigned char> work(image.pixels.size());
+
+    for (const Method &method : pixel_methods(image.width, image.height))
+    {
+        const std::string payload = make_payload(method.capacity, 7);
+
+        unsigned char *decoded = nullptr;
+        const double decode = measure([&] { stbi_image_free(decoded); decoded = nullptr; },
+                                      [&] {
+                                          int w, h;
+                                          decoded = decode_png(image.png, &w, &h);
+                                      },
+                                      options.min_time);
+        if (!decoded)
+        {
+            throw std::runtime_error("Failed to load image");
+        }
+        stbi_image_free(decoded);
+
+        const double embed = measure([&] { std::copy(image.pixels.begin(), image.pixels.end(), work.begin()); },
+                                     [&] { method.embed(work.data(), payload); }, options.min_time);
+
+        std::string extracted;
+        const double extract = measure([] {}, [&] { extracted = method.extract(work.data(), payload.size()); },
+                                       options.min_time);
+        // CD re-selects its channel from modified values and CS cannot encode R == G, so misses are reported, not fatal
+        if (extracted != payload)
+            fprintf(stderr, "warning: %s round trip differs on %s %s\n", method.name.c_str(), image.name.c_str(),
+                    image.content.c_str());
+
+        std::string png;
+        const double encode = measure([&] { png.clear(); },
+                                      [&] { png = encode_png(work.data(), image.width, image.height, 3); },
+                                      options.min_time);
+
+        print_stage(image, method.name, "decode", decode, raw_bytes);
+        print_stage(image, method.name, "embed", embed, raw_bytes);
+        print_stage(image, method.name, "extract", extract, raw_bytes);
+        print_stage(image, method.name, "encode", encode, raw_bytes);
+    }
+
+    // EOF never decodes pixels: embedding is carrier copy plus append, extraction is a tail slice
+    const std::string payload = make_payload(image.png.size() / 8 + 1, 7);
+    const double file_bytes = static_cast<double>(image.png.size() + payload.size());
+    std::string container;
+    const double embed = measure([&] { container.clear(); container.shrink_to_fit(); },
+                                 [&] {
+                                     container.reserve(image.png.size() + payload.size());
+                                     container.assign(image.png);
+                                     container += payload;
+                                 },
+                                 options.min_time);
+    std::string tail;
+    const double extract =
+        measure([] {}, [&] { tail.assign(container, container.size() - payload.size(), payload.size()); },
+                options.min_time);
+    if (tail != payload)
+    {
+        throw std::runtime_error("Benchmark round trip failed for eof");
+    }
+    print_stage(image, "eof", "embed", embed, file_bytes);
+    print_stage(image, "eof", "extract", extract, file_bytes);
+}
+
+// Batch throughput: every task runs decode, embed kernel and encode on its own carrier copy
+void bench_scaling(const SyntheticImage &image, const Options &options)
+{
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> thread_counts;
+    for (unsigned t = 1; t < hardware; t *= 2)
+        thread_counts.push_back(t);
+    thread_counts.push_back(hardware);
+
+    const size_t batch = 2 * hardware;
+    printf("\nthread scaling: %zu x %s %s images, decode + embed + encode per image\n", batch, image.name.c_str(),
+           image.content.c_str());
+    printf("%-9s %8s %12s %12s %10s\n", "method", "threads", "images/s", "MB/s", "speedup");
+
+    for (const Method &method : pixel_methods(image.width, image.height))
+    {
+        const std::string payload = make_payload(method.capacity, 7);
+        double single = 0;
+        for (unsigned threads : thread_counts)
+        {
+            const double seconds = measure([] {},
+                                           [&] {
+                                               parallel_for(batch, [&](size_t) {
+                                                   int w, h;
+                                                   unsigned char *px = decode_png(image.png, &w, &h);
+                                                   if (!px)
+                                                   {
+                                                       throw std::runtime_error("Failed to load image");
+                                                   }
+                                                   std::unique_ptr<unsigned char, void (*)(void *)> guard(
+                                                       px, stbi_image_free);
+                                                   method.embed(px, payload);
+                                                   encode_png(px, w, h, 3);
+                                               }, threads);
+                                           },
+                                           options.min_time);
+            if (threads == 1)
+                single = seconds;
+            printf("%-9s %8u %12.2f %12.1f %10.2f\n", method.name.c_str(), threads, batch / seconds,
+                   batch * static_cast<double>(image.pixels.size()) / seconds / 1e6, single / seconds);
+        }
+    }
+}
+
+// Scalar per-byte loop with a serial dependency, the same shape as the embedding loops. Throughput is
+// reported relative to it, so the baseline holds across machines and compilers of similar quality
+double calibration_mbps(const std::vector<unsigned char> &pixels, double min_time)
+{
+    volatile uint32_t sink = 0;
+    const double seconds = measure([] {},
+                                   [&] {
+                                       uint32_t acc = 0;
+                                       for (unsigned char v : pixels)
+                                           acc = acc * 31 + v;
+                                       sink = acc;
+                                   },
+                                   min_time);
+    (void)sink;
+    return pixels.size() / seconds / 1e6;
+}
+
+struct RoundTrip
+{
+    std::string method;
+    double mbps;
+    double relative;
+};
+
+// Embed plus extract kernels of every method on a fixed VGA photo-like carrier
+std::vector<RoundTrip> round_trips(double min_time, double &calibration)
+{
+    const int width = 640, height = 480;
+    const std::vector<unsigned char> pixels = make_pixels(width, height, true, 12345);
+    const double bytes = static_cast<double>(pixels.size());
+    std::vector<unsigned char> work(pixels.size());
+    calibration = calibration_mbps(pixels, min_time);
+
+    std::vector<RoundTrip> results;
+    for (const Method &method : pixel_methods(width, height))
+    {
+        const std::string payload = make_payload(method.capacity, 7);
+        const double seconds = measure([&] { std::copy(pixels.begin(), pixels.end(), work.begin()); },
+                                       [&] {
+                                           method.embed(work.data(), payload);
+                                           method.extract(work.data(), payload.size());
+                                       },
+                                       min_time);
+        results.push_back({method.name, bytes / seconds / 1e6, 0});
+    }
+
+    // EOF works on files, so the carrier goes through a temp file and every round trip copies it and appends
+    const std::string carrier = encode_png(pixels.data(), width, height, 3);
+    const std::string payload = make_payload(carrier.size() / 8, 7);
+    const std::filesystem::path temp = std::filesystem::temp_directory_path();
+    const std::string carrier_file = (temp / ("stego_bench_" + std::to_string(getpid()) + ".png")).string();
+    const std::string stego_file = (temp / ("stego_bench_" + std::to_string(getpid()) + "_eof.png")).string();
+    write_file(carrier_file, carrier);
+    EOFHiding eof;
+    const double seconds = measure([] {},
+                                   [&] {
+                                       eof.encode(carrier_file, payload, stego_file);
+                                       if (eof.decode(stego_file, static_cast<long long int>(payload.size())) !=
+                                           payload)
+                                           throw std::runtime_error("Benchmark round trip failed for eof");
+                                   },
+                                   min_time);
+    std::filesystem::remove(carrier_file);
+    std::filesystem::remove(stego_file);
+    results.push_back({"eof", (carrier.size() + payload.size()) / seconds / 1e6, 0});
+
+    for (auto &result : results)
+        result.relative = result.mbps / calibration;
+    return results;
+}
+
+void write_baseline(const std::string &path, const std::vector<RoundTrip> &results, double calibration)
+{
+    std::ostringstream out;
+    out.precision(4);
+    out << std::fixed << "{\n  \"carrier\": \"vga photo\",\n  \"calibration_mbps\": " << calibration
+        << ",\n  \"methods\": {\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        out << "    \"" << results[i].method << "\": {\"mbps\": " << results[i].mbps
+            << ", \"relative\": " << results[i].relative << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  }\n}\n";
+    write_file(path, out.str());
+}
+
+// Baseline is written by write_baseline only, so a key lookup is enough instead of a JSON parser
+double baseline_relative(const std::string &json, const std::string &method)
+{
+    const size_t key = json.find("\"" + method + "\": {");
+    if (key == std::string::npos)
+        return 0;
+    const size_t value = json.find("\"relative\": ", key);
+    if (value == std::string::npos)
+        return 0;
+    return std::stod(json.substr(value + 12));
+}
+
+// Adaptive LSB round trip time limit, in plain LSB round trips on the same carrier
+const double ADAPTIVE_MAX_SLOWDOWN = 1.5;
+
+// The texture map is the only work on top of plain LSB. Both round trips alternate in one loop, so a host
+// that changes speed during the run slows them alike and the ratio holds across machines
+double adaptive_slowdown(double min_time)
+{
+    const int width = 640, height = 480;
+    const std::vector<unsigned char> pixels = make_pixels(width, height, true, 12345);
+    std::vector<unsigned char> work(pixels.size());
+    std::vector<Method> methods;
+    std::vector<std::string> payloads;
+    for (Method &method : pixel_methods(width, height))
+    {
+        if (method.name != "lsb" && method.name != "lsb adapt")
+            continue;
+        payloads.push_back(make_payload(method.capacity, 7));
+        methods.push_back(std::move(method));
+    }
+
+    double best[2] = {1e300, 1e300}, total = 0;
+    do
+    {
+        for (size_t i = 0; i < methods.size(); ++i)
+        {
+            std::copy(pixels.begin(), pixels.end(), work.begin());
+            const auto start = Clock::now();
+            methods[i].embed(work.data(), payloads[i]);
+            methods[i].extract(work.data(), payloads[i].size());
+            const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            best[i] = std::min(best[i], elapsed);
+            total += elapsed;
+        }
+    } while (total < 2 * min_time);
+    return best[1] / best[0];
+}
+
+int check_regressions(const Options &options)
+{
+    double calibration = 0;
+    const std::vector<RoundTrip> results = round_trips(std::max(options.min_time, 0.1), calibration);
+    if (!options.update_baseline.empty())
+    {
+        write_baseline(options.update_baseline, results, calibration);
+        printf("baseline written to %s\n", options.update_baseline.c_str());
+        return 0;
+    }
+
+    const std::string baseline = read_file_to_string(options.check_baseline);
+    int failures = 0;
+    printf("calibration %.1f MB/s, tolerance %.0f%%\n", calibration, options.tolerance * 100);
+    printf("%-9s %12s %10s %10s %8s\n", "method", "MB/s", "relative", "baseline", "result");
+    for (const auto &result : results)
+    {
+        const double expected = baseline_relative(baseline, result.method);
+        const bool missing = expected <= 0;
+        const bool regressed = !missing && result.relative < expected * (1 - options.tolerance);
+        failures += regressed || missing;
+        printf("%-9s %12.1f %10.4f %10.4f %8s\n", result.method.c_str(), result.mbps, result.relative, expected,
+               missing ? "MISSING" : regressed ? "SLOWER" : "ok");
+    }
+
+    const double slowdown = adaptive_slowdown(std::max(options.min_time, 0.1));
+    const bool adaptive_slow = slowdown > ADAPTIVE_MAX_SLOWDOWN;
+    failures += adaptive_slow;
+    printf("lsb adapt round trip %.2fx of lsb, limit %.2fx %8s\n", slowdown, ADAPTIVE_MAX_SLOWDOWN,
+           adaptive_slow ? "SLOWER" : "ok");
+    if (failures > 0)
+        fprintf(stderr, "%d method(s) regressed beyond tolerance or are missing in %s\n", failures,
+                options.check_baseline.c_str());
+    return failures > 0 ? 1 : 0;
+}
+
+Options parse_options(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--max-mp") == 0 && i + 1 < argc)
+            options.max_mp = std::stod(argv[++i]);
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            options.min_time = std::stod(argv[++i]);
+        else if (strcmp(argv[i], "--no-scaling") == 0)
+            options.scaling = false;
+        else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc)
+            options.check_baseline = argv[++i];
+        else if (strcmp(argv[i], "--update") == 0 && i + 1 < argc)
+            options.update_baseline = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+            options.tolerance = std::stod(argv[++i]);
+        else
+            throw std::runtime_error(std::string("Unknown option: ") + argv[i]);
+    }
+    return options;
+}
+} // namespace
+
+/**
+ * \brief Запускает бенчмарк: `stego_bench [--max-mp N] [--min-time S] [--no-scaling]`
+ *
+ * Для каждого размера (от миниатюры до 100 Мп, не больше --max-mp) и каждого вида
+ * содержимого (шум и фото) печатает MB/s и ns/pixel стадий decode, embed, extract и
+ * encode методов lsb (b = 1..4), lsb adapt, qim (q = 4, 8, 16), cd, cs, mbc и eof.
+ * Каждая стадия повторяется, пока суммарное время не превысит --min-time секунд,
+ * берётся лучший прогон. Затем измеряется масштабирование пакетной обработки по
+ * числу потоков.
+ *
+ * `--check <baseline.json> [--tolerance T]` прогоняет embed + extract каждого метода на
+ * фиксированном VGA-контейнере и завершается с кодом 1, если скорость относительно
+ * калибровочного цикла упала больше чем на долю T (по умолчанию 0.5) от базовой или
+ * lsb adapt стал медленнее lsb больше чем в ADAPTIVE_MAX_SLOWDOWN раз;
+ * `--update <baseline.json>` перезаписывает базовые значения.
+ */
+int main(int argc, char *argv[])
+{
+    try
+    {
+        const Options options = parse_options(argc, argv);
+        if (!options.check_baseline.empty() || !options.update_baseline.empty())
+            return check_regressions(options);
+        print_header();
+
+        SyntheticImage scaling_image;
+        for (const ImageSize &size : SIZES)
+        {
+            if (static_cast<double>(size.width) * size.height / 1e6 > options.max_mp)
+                continue;
+            for (bool photo : {false, true})
+            {
+                SyntheticImage image;
+                image.name = size.name;
+                image.content = photo ? "photo" : "noise";
+                image.width = size.width;
+                image.height = size.height;
+                image.pixels = make_pixels(size.width, size.height, photo, 12345);
+                image.png = encode_png(image.pixels.data(), size.width, size.height, 3);
+                bench_image(image, options);
+                // Full HD photo is the typical batch carrier; smaller limits fall back to the largest size run
+                if (photo && (scaling_image.pixels.empty() || size.width <= 1920))
+                    scaling_image = std::move(image);
+            }
+        }
+
+        if (options.scaling && !scaling_image.pixels.empty())
+            bench_scaling(scaling_image, options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include "headers.h"
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+const char SIDECAR_MAGIC[8] = {'S', 'T', 'E', 'G', 'R', 'A', 'W', '1'};
+const char *SIDECAR_EXTENSION = ".raw";
+
+struct SidecarHeader
+{
+    char magic[8];
+    uint64_t path_hash;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t stored_channels;
+};
+
+std::mutex config_mutex;
+std::string cache_dir;
+uint64_t cache_limit = 0;
+
+struct Source
+{
+    uint64_t path_hash;
+    uint64_t size;
+    int64_t mtime;
+};
+
+uint64_t fnv1a(const std::string &text, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    for (unsigned char c : text)
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    return hash;
+}
+
+// Path, size and mtime identify the source without reading it; a rewritten PNG changes at least the mtime
+bool describe_source(const std::string &path, int desired_channels, Source &source)
+{
+    std::error_code ec;
+    const fs::path canonical = fs::weakly_canonical(path, ec);
+    if (ec)
+        return false;
+    source.size = fs::file_size(canonical, ec);
+    if (ec)
+        return false;
+    const auto mtime = fs::last_write_time(canonical, ec);
+    if (ec)
+        return false;
+    source.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    source.path_hash = fnv1a(canonical.string() + '\0' + std::to_string(desired_channels));
+    return true;
+}
+
+fs::path sidecar_path(const std::string &dir, const Source &source)
+{
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(source.path_hash));
+    return fs::path(dir) / (std::string(name) + SIDECAR_EXTENSION);
+}
+
+// Oldest sidecars go first; hits refresh the mtime, so this is least recently used
+void evict(const std::string &dir, uint64_t limit)
+{
+    std::vector<std::pair<fs::file_time_type, fs::path>> files;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto &entry : fs::directory_iterator(dir, ec))
+    {
+        if (entry.path().extension() != SIDECAR_EXTENSION)
+            continue;
+        std::error_code entry_ec;
+        const uint64_t size = entry.file_size(entry_ec);
+        const auto time = entry.last_write_time(entry_ec);
+        if (entry_ec)
+            continue;
+        total += size;
+        files.emplace_back(time, entry.path());
+    }
+    if (total <= limit)
+        return;
+
+    std::sort(files.begin(), files.end());
+    for (const auto &file : files)
+    {
+        if (total <= limit)
+            break;
+        std::error_code remove_ec;
+        const uint64_t size = fs::file_size(file.second, remove_ec);
+        if (!remove_ec && fs::remove(file.second, remove_ec))
+            total -= size;
+    }
+}
+} // namespace
+
+void carrier_cache_configure(const std::string &dir, uint64_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(config_mutex);
+    cache_dir = dir;
+    cache_limit = max_bytes;
+    if (!dir.empty())
+    {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        if (ec)
+        {
+            cache_dir.clear();
+            throw std::runtime_error("Failed to create cache directory: " + dir);
+        }
+    }
+}
+
+std::string carrier_cache_dir()
+{
+    std::lock_guard<std::mutex> lock(config_mutex);
+    return cache_dir;
+}
+
+unsigned char *carrier_cache_load(const std::string &path, int *width, int *height, int *channels,
+                                  int desired_channels)
+{
+    const std::string dir = carrier_cache_dir();
+    Source source;
+    if (dir.empty() || path == "-" || !describe_source(path, desired_channels, source))
+        return nullptr;
+
+    const fs::path sidecar = sidecar_path(dir, source);
+    std::error_code ec;
+    if (!fs::exists(sidecar, ec))
+    {
+        stats_add(CACHE_MISSES, 1);
+        return nullptr;
+    }
+
+    try
+    {
+        MappedFile file(sidecar.string());
+        SidecarHeader header;
+        if (file.size() < sizeof(header))
+        {
+            stats_add(CACHE_MISSES, 1);
+            return nullptr;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        const size_t pixels = static_cast<size_t>(header.width) * header.height * header.stored_channels;
+        if (!std::equal(SIDECAR_MAGIC, SIDECAR_MAGIC + 8, header.magic) || header.path_hash != source.path_hash ||
+            header.source_size != source.size || header.source_mtime != source.mtime ||
+            file.size() != sizeof(header) + pixels)
+        {
+            stats_add(CACHE_MISSES, 1);
+            return nullptr;
+        }
+
+        // Callers own and modify the buffer and release it with stbi_image_free, so the mapping is copied
+        unsigned char *data = static_cast<unsigned char *>(std::malloc(pixels ? pixels : 1));
+        if (!data)
+            return nullptr;
+        std::memcpy(data, file.data() + sizeof(header), pixels);
+        *width = static_cast<int>(header.width);
+        *height = static_cast<int>(header.height);
+        *channels = static_cast<int>(header.channels);
+        stats_add(CACHE_HITS, 1);
+        stats_add(BYTES_READ, file.size());
+        fs::last_write_time(sidecar, fs::file_time_type::clock::now(), ec);
+        return data;
+    }
+    catch (const std::runtime_error &)
+    {
+        stats_add(CACHE_MISSES, 1);
+        return nullptr;
+    }
+}
+
+void carrier_cache_store(const std::string &path, const unsigned char *data, int width, int height, int channels,
+                         int desired_channels)
+{
+    std::string dir;
+    uint64_t limit;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex);
+        dir = cache_dir;
+        limit = cache_limit;
+    }
+    Source source;
+    if (dir.empty() || path == "-" || !data || !describe_source(path, desired_channels, source))
+        return;
+
+    SidecarHeader header;
+    std::memcpy(header.magic, SIDECAR_MAGIC, 8);
+    header.path_hash = source.path_hash;
+    header.source_size = source.size;
+    header.source_mtime = source.mtime;
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.channels = static_cast<uint32_t>(channels);
+    header.stored_channels = static_cast<uint32_t>(desired_channels ? desired_channels : channels);
+    const size_t pixels = static_cast<size_t>(width) * height * header.stored_channels;
+    if (limit > 0 && sizeof(header) + pixels > limit)
+        return;
+
+    // Written under a unique name and renamed, so concurrent runs never map a half-written sidecar
+    const fs::path sidecar = sidecar_path(dir, source);
+    const fs::path temp = sidecar.string() + "." + std::to_string(std::random_device()()) + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary);
+        if (!out.is_open())
+            return;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(data), pixels);
+        if (!out)
+        {
+            out.close();
+            std::error_code ec;
+            fs::remove(temp, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp, sidecar, ec);
+    if (ec)
+    {
+        fs::remove(temp, ec);
+        return;
+    }
+    if (limit > 0)
+        evict(dir, limit);
+}
@@ -6,14 +6,22 @@
 #ifndef HEADERS_H
 #include "stb_image.h"
 #include "stb_image_write.h"
+#include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 #include <filesystem>
 #include <sstream>
@@ -31,69 +39,793 @@ struct ImageData
 	ImageData();
 };
 
+/**
+ * \brief Размер блока перестановки в байтах, подобран под L1-кэш
+ */
+const size_t SCATTER_BLOCK_BYTES = 16384;
+
+/**
+ * \brief Ключевая псевдослучайная перестановка позиций носителя
+ *
+ * Порядок двухуровневый: блоки размером SCATTER_BLOCK_BYTES переставляются между собой,
+ * а элементы - внутри своего блока. Обе перестановки вычисляются сетью Фейстеля над
+ * счётчиковым ГПСЧ, поэтому таблица не хранится, а обход остаётся локальным по кэшу.
+ * С пустым ключом перестановка тождественна и методы пишут биты подряд, как раньше.
+ */
+class ScatterOrder
+{
+public:
+	/**
+	 * \brief Создаёт перестановку
+	 * \param count Количество позиций (байтов канала или пикселей)
+	 * \param key Секретный ключ; пустая строка отключает перемешивание
+	 * \param element_size Размер одной позиции в байтах, определяет длину блока
+	 */
+	ScatterOrder(size_t count, const std::string &key, size_t element_size = 1);
+
+	/**
+	 * \brief Возвращает физическую позицию для логического индекса i
+	 */
+	size_t at(size_t i) const;
+
+	/**
+	 * \brief Количество позиций
+	 */
+	size_t size() const;
+
+	/**
+	 * \brief Включено ли перемешивание
+	 */
+	bool keyed() const;
+
+private:
+	size_t count;
+	size_t block;
+	size_t full_blocks;
+	uint64_t seed;
+	bool enabled;
+};
+
 /**
  * \brief Читает содержимое файла в строку
  *
- * \param file_path Путь к файлу для чтения
+ * \param file_path Путь к файлу для чтения, "-" - стандартный ввод
  * \return std::string Содержимое файла в виде строки
  * \throw std::runtime_error Если файл не может быть открыт
  */
 std::string read_file_to_string(const std::string &file_path);
 
+/**
+ * \brief Записывает строку в файл без преобразований
+ * \param path Путь к файлу, "-" - стандартный вывод
+ * \param data Записываемые данные
+ * \throw std::runtime_error Если файл не может быть открыт
+ */
+void write_file(const std::string &path, const std::string &data);
+
+/**
+ * \brief Раскрывает каталоги в отсортированный список *.png, остальные пути оставляет как есть
+ * \param paths Пути к изображениям и каталогам
+ * \return Список путей к изображениям
+ */
+std::vector<std::string> expand_image_paths(const std::vector<std::string> &paths);
+
+/**
+ * \brief Файл, отображённый в память только для чтения
+ *
+ * Обычные файлы отображаются через mmap без копирования, каналы и устройства,
+ * которые отобразить нельзя, прочитываются в буфер.
+ */
+class MappedFile
+{
+public:
+	/**
+	 * \brief Открывает и отображает файл
+	 * \param path Путь к файлу
+	 * \throw std::runtime_error Если файл не может быть открыт или прочитан
+	 */
+	explicit MappedFile(const std::string &path);
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	/**
+	 * \brief Начало содержимого файла
+	 */
+	const char *data() const;
+
+	/**
+	 * \brief Размер файла в байтах
+	 */
+	size_t size() const;
+
+private:
+	void *mapping = nullptr;
+	const char *bytes = nullptr;
+	size_t length = 0;
+	std::vector<char> buffer;
+};
+
+/**
+ * \brief Копирует файл средствами ядра
+ *
+ * Сначала пробует reflink (FICLONE), затем copy_file_range и sendfile,
+ * в последнюю очередь - обычный цикл read/write.
+ * \param src Исходный файл
+ * \param dst Файл назначения, перезаписывается
+ * \throw std::runtime_error Если файлы не открываются или копирование прервалось
+ */
+void copy_file_contents(const std::string &src, const std::string &dst);
+
+/**
+ * \brief Загружает изображение через png_decode или stb_image, для "-" декодирует стандартный ввод из памяти
+ *
+ * Если настроен кэш носителей, пиксели берутся из файла-спутника без декодирования,
+ * а после промаха декодированное изображение сохраняется в кэш.
+ * \param path Путь к изображению или "-"
+ * \param width Ширина изображения
+ * \param height Высота изображения
+ * \param channels Количество каналов в файле
+ * \param desired_channels Требуемое количество каналов, 0 - как в файле
+ * \return unsigned char* Пиксели (освобождаются stbi_image_free) или nullptr при ошибке
+ */
+unsigned char *load_image(const std::string &path, int *width, int *height, int *channels, int desired_channels);
+
+/**
+ * \brief Быстрый декодер PNG для 8-битных RGB и RGBA без чересстрочности
+ *
+ * Собственный inflate с двухуровневыми таблицами Хаффмана (10 бит за один поиск)
+ * читает поток слово за словом, фильтры строк снимаются SSE2: Up и Sub по 16 байтов,
+ * Avg и Paeth попиксельно в регистре. Остальные форматы (палитра, серый, 16 бит,
+ * tRNS, interlace) и повреждённые файлы возвращают nullptr, их декодирует stb_image.
+ * \param data Содержимое PNG-файла
+ * \param size Размер содержимого в байтах
+ * \param channels Количество каналов в файле
+ * \param desired_channels Требуемое количество каналов: 0 - как в файле, 3 или 4
+ * \return unsigned char* Пиксели (освобождаются stbi_image_free) или nullptr
+ */
+unsigned char *png_decode(const unsigned char *data, size_t size, int *width, int *height, int *channels,
+						  int desired_channels);
+
+/**
+ * \brief Читает размеры изображения без декодирования пикселей
+ * \param path Путь к изображению или "-"
+ * \return bool Удалось ли прочитать заголовок
+ */
+bool image_info(const std::string &path, int *width, int *height, int *channels);
+
+/**
+ * \brief Сохраняет пиксели в PNG, для "-" кодирует в стандартный вывод через stbi_write_png_to_func
+ * \param path Путь к файлу или "-"
+ * \param data Пиксели построчно без выравнивания
+ * \return bool Удалось ли записать изображение
+ */
+bool write_image(const std::string &path, int width, int height, int channels, const unsigned char *data);
+
+// Carrier cache
+
+/**
+ * \brief Включает кэш декодированных носителей между запусками
+ *
+ * Для каждого изображения в каталоге хранится файл-спутник: заголовок (размеры,
+ * каналы, хеш пути, размер и время изменения исходного файла) и сырые пиксели.
+ * Повторная загрузка отображает спутник через mmap вместо распаковки PNG; спутник
+ * устаревает при изменении исходного файла. Когда суммарный размер превышает
+ * max_bytes, удаляются давно не использованные спутники.
+ * \param dir Каталог кэша, создаётся при необходимости; пустая строка выключает кэш
+ * \param max_bytes Предельный размер кэша в байтах, 0 - без ограничения
+ * \throw std::runtime_error Если каталог не может быть создан
+ */
+void carrier_cache_configure(const std::string &dir, uint64_t max_bytes);
+
+/**
+ * \brief Каталог кэша носителей, пустая строка - кэш выключен
+ */
+std::string carrier_cache_dir();
+
+/**
+ * \brief Загружает пиксели из кэша
+ * \return unsigned char* Копия пикселей (освобождается stbi_image_free) или nullptr при промахе
+ */
+unsigned char *carrier_cache_load(const std::string &path, int *width, int *height, int *channels,
+								  int desired_channels);
+
+/**
+ * \brief Сохраняет декодированные пиксели в кэш, ошибки записи не прерывают работу
+ */
+void carrier_cache_store(const std::string &path, const unsigned char *data, int width, int height, int channels,
+						 int desired_channels);
+
+// Statistics
+
+/**
+ * \brief Фазы обработки, время которых собирается при включённой статистике
+ */
+enum StatPhase
+{
+	PHASE_READ,
+	PHASE_DECODE,
+	PHASE_MESSAGE,
+	PHASE_EMBED,
+	PHASE_EXTRACT,
+	PHASE_ENCODE,
+	PHASE_WRITE,
+	PHASE_ANALYZE,
+	PHASE_COUNT
+};
+
+/**
+ * \brief Счётчики статистики
+ */
+enum StatCounter
+{
+	BYTES_READ,
+	BYTES_WRITTEN,
+	PIXELS_TOUCHED,
+	ALLOCATIONS,
+	ALLOCATED_BYTES,
+	CACHE_HITS,
+	CACHE_MISSES,
+	COUNTER_COUNT
+};
+
+/**
+ * \brief Включает или выключает сбор статистики для всего процесса
+ */
+void stats_enable(bool on);
+
+/**
+ * \brief Включён ли сбор статистики
+ */
+bool stats_enabled();
+
+/**
+ * \brief Обнуляет все фазы и счётчики
+ */
+void stats_reset();
+
+/**
+ * \brief Прибавляет value к счётчику, если статистика включена
+ */
+void stats_add(StatCounter counter, uint64_t value);
+
+uint64_t stats_counter(StatCounter counter);
+uint64_t stats_phase_calls(StatPhase phase);
+uint64_t stats_phase_ns(StatPhase phase);
+
+/**
+ * \brief Сериализует накопленную статистику в однострочный JSON
+ *
+ * Время фаз суммируется по всем вызовам и потокам, поэтому в пакетных режимах
+ * (shard, analyze, кадры gif) сумма может превышать общее время wall_ms.
+ * Счётчик pixels_touched считает байты каналов, прочитанные или изменённые ядрами.
+ * \param command Имя команды для отчёта
+ */
+std::string stats_to_json(const std::string &command = "");
+
+/**
+ * \brief Аппаратные счётчики, снимаемые perf_event_open вокруг фаз
+ */
+enum PerfEvent
+{
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_REFERENCES,
+	PERF_CACHE_MISSES,
+	PERF_BRANCHES,
+	PERF_BRANCH_MISSES,
+	PERF_EVENT_COUNT
+};
+
+struct PerfSample
+{
+	uint64_t values[PERF_EVENT_COUNT];
+};
+
+/**
+ * \brief Включает аппаратные счётчики для фаз статистики
+ *
+ * Каждый поток открывает свою группу счётчиков (только пользовательский режим) при
+ * первой фазе. Если счётчики недоступны (нет PMU, perf_event_paranoid, не Linux),
+ * режим остаётся выключенным, а причина доступна через perf_counters_status.
+ * \return bool Удалось ли открыть счётчики
+ */
+bool perf_counters_enable(bool on);
+
+bool perf_counters_enabled();
+
+/**
+ * \brief Состояние счётчиков: "enabled", "partial", "disabled" или "unavailable: причина"
+ *
+ * "partial" означает, что часть событий или часть потоков не удалось открыть; отказ
+ * рабочего потока после успешного открытия в основном потоке не делает режим "unavailable".
+ */
+std::string perf_counters_status();
+
+/**
+ * \brief Читает текущие значения счётчиков вызывающего потока
+ * \return bool false, если счётчики потока не открыты
+ */
+bool perf_counters_read(PerfSample &sample);
+
+/**
+ * \brief Замеряет монотонными часами время от создания до разрушения и добавляет его к фазе
+ */
+class PhaseTimer
+{
+public:
+	explicit PhaseTimer(StatPhase phase);
+	~PhaseTimer();
+
+	/**
+	 * \brief Завершает замер раньше конца области видимости
+	 */
+	void stop();
+	PhaseTimer(const PhaseTimer &) = delete;
+	PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+	StatPhase phase;
+	bool active;
+	bool counting = false;
+	std::chrono::steady_clock::time_point start;
+	PerfSample perf_start;
+};
+
+// Distortion
+
+/**
+ * \brief Накопленное искажение носителя по всем встраиваниям процесса
+ *
+ * Отсчёты - байты каналов носителя (как pixels_touched), изменённые и нет.
+ */
+struct DistortionTotals
+{
+	uint64_t sse = 0;
+	uint64_t changed = 0;
+	uint64_t samples = 0;
+	unsigned max_delta = 0;
+};
+
+/**
+ * \brief Включает или выключает учёт искажения для всего процесса
+ */
+void distortion_enable(bool on);
+
+/**
+ * \brief Включён ли учёт искажения
+ */
+bool distortion_enabled();
+
+/**
+ * \brief Обнуляет накопленное искажение
+ */
+void distortion_reset();
+
+/**
+ * \brief Возвращает накопленное искажение
+ */
+DistortionTotals distortion_totals();
+
+/**
+ * \brief Вычисляет PSNR в децибелах для 8-битных каналов
+ * \return double Бесконечность, если носитель не изменился
+ */
+double distortion_psnr(const DistortionTotals &totals);
+
+/**
+ * \brief Сериализует накопленное искажение (SSE, MSE, max_delta, changed, PSNR) в однострочный JSON
+ */
+std::string distortion_to_json();
+
+/**
+ * \brief Локальный счётчик искажения одного ядра встраивания
+ *
+ * Ядро сообщает каждую запись в носитель через record, итог добавляется к общему
+ * при разрушении, если учёт включён. Суммы копятся в регистрах, при выключенном
+ * учёте record сводится к одной хорошо предсказуемой проверке.
+ */
+class DistortionMeter
+{
+public:
+	/**
+	 * \param samples Количество байтов каналов в носителе
+	 */
+	explicit DistortionMeter(size_t samples);
+	~DistortionMeter();
+	DistortionMeter(const DistortionMeter &) = delete;
+	DistortionMeter &operator=(const DistortionMeter &) = delete;
+
+	/**
+	 * \brief Был ли учёт включён при создании счётчика
+	 */
+	bool enabled() const
+	{
+		return active;
+	}
+
+	/**
+	 * \brief Учитывает замену значения канала before на after
+	 */
+	void record(int before, int after)
+	{
+		if (!active)
+			return;
+		const int delta = after - before;
+		sse += static_cast<uint64_t>(delta * delta);
+		changed += delta != 0;
+		max_delta = std::max(max_delta, static_cast<unsigned>(std::abs(delta)));
+	}
+
+	/**
+	 * \brief Добавляет уже посчитанные суммы (векторные ядра)
+	 */
+	void add(uint64_t span_sse, uint64_t span_changed, unsigned span_max_delta)
+	{
+		sse += span_sse;
+		changed += span_changed;
+		max_delta = std::max(max_delta, span_max_delta);
+	}
+
+private:
+	uint64_t sse = 0;
+	uint64_t changed = 0;
+	uint64_t samples;
+	unsigned max_delta = 0;
+	bool active;
+};
+
+/**
+ * \brief Вычисляет контрольную сумму CRC-32 (полином IEEE 802.3)
+ * \param data Указатель на данные
+ * \param size Размер данных в байтах
+ * \param crc Значение для продолжения подсчёта по частям
+ * \return uint32_t Контрольная сумма
+ */
+uint32_t crc32(const char *data, size_t size, uint32_t crc = 0);
+
+/**
+ * \brief Выполняет fn(i) для i из [0, count) на пуле потоков
+ *
+ * Задачи раздаются через атомарный счётчик, первое исключение из задачи
+ * пробрасывается вызывающему после завершения всех потоков.
+ * \param count Количество задач
+ * \param fn Функция, вызываемая с индексом задачи
+ * \param threads Количество потоков, 0 - по числу ядер
+ */
+template <typename F> void parallel_for(size_t count, F &&fn, unsigned threads = 0)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+	if (threads <= 1)
+	{
+		for (size_t i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&]() {
+			for (size_t i = next++; i < count; i = next++)
+			{
+				try
+				{
+					fn(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error)
+						error = std::current_exception();
+					next = count;
+				}
+			}
+		});
+	}
+	for (auto &worker : workers)
+		worker.join();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+/**
+ * \brief Включает проверку после встраивания для всего процесса
+ *
+ * Каждое ядро встраивания сразу прогоняет соответствующее ядро извлечения по
+ * изменённому буферу в памяти (до кодирования PNG) и при несовпадении с сообщением
+ * бросает std::runtime_error, результат при этом не записывается. Для eof и chunk
+ * перечитывается только записанный хвост файла.
+ */
+void embed_verify_enable(bool on);
+
+bool embed_verify_enabled();
+
 /**
  * \brief Встраивает сообщение в изображение методом QIM
  * \param original Путь к исходному изображению
  * \param stego Путь для сохранения стего-изображения
  * \param msg_file Путь к файлу с встраиваемым сообщением
  * \param q_str Параметр квантования
+ * \param key Ключ псевдослучайного рассеивания битов (пустой - последовательная запись)
  * \throw std::runtime_error Если файл не может быть открыт
  */
 void qim_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
-			   const std::string &q_str);
+			   const std::string &q_str, const std::string &key = "");
 
 /**
  * \brief Извлекает сообщение из стего-изображения методом QIM
  * \param stego Путь к стего-изображению
  * \param q_str Параметр квантования
  * \param output_file Путь для сохранения извлеченного сообщения
+ * \param key Ключ, использованный при встраивании
  * \throw std::runtime_error Если файл не может быть открыт
  */
-void qim_extract(const std::string &stego, const std::string &q_str, const std::string &output_file);
+void qim_extract(const std::string &stego, const std::string &q_str, const std::string &output_file,
+				 const std::string &key = "");
 
 /**
  * \brief Встраивает сообщение в изображение методом LSB
  * \param original Путь к исходному изображению
  * \param stego Путь для сохранения стего-изображения
  * \param msg_file Путь к файлу с сообщением для встраивания
- * \throw std::runtime_error Если файл не может быть открыт
+ * \param key Ключ псевдослучайного рассеивания битов (пустой - последовательная запись)
+ * \param bits Количество младших битов на байт канала, от 1 до 4
+ * \throw std::runtime_error Если файл не может быть открыт или сообщение не помещается
  */
-void lsb_embed(const std::string &original, const std::string &stego, const std::string &msg_file);
+void lsb_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
+			   const std::string &key = "", int bits = 1);
 
 /**
  * \brief Извлекает сообщение из стего-изображения методом LSB
  * \param stego Путь к стего-изображению
  * \param output_file Путь для сохранения извлеченного сообщения
+ * \param key Ключ, использованный при встраивании
+ * \param bits Количество младших битов на байт канала, использованное при встраивании
  * \throw std::runtime_error Если файл не может быть открыт
  */
-void lsb_extract(const std::string &stego, const std::string &output_file);
+void lsb_extract(const std::string &stego, const std::string &output_file, const std::string &key = "",
+				 int bits = 1);
 
 /**
  * \brief Встраивает сообщение в изображение методом CD
  * \param original Путь к исходному изображению
  * \param stego Путь для сохранения стего-изображения
  * \param msg_file Путь к файлу с сообщением для встраивания
+ * \param key Ключ псевдослучайного рассеивания битов (пустой - последовательная запись)
  * \throw std::runtime_error Если файл не может быть открыт
  */
-void cd_embed(const std::string &original, const std::string &stego, const std::string &msg_file);
+void cd_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
+			   const std::string &key = "");
 
 /**
  * \brief Извлекает сообщение из стего-изображения методом CD
  * \param stego Путь к стего-изображению
  * \param output_file Путь для сохранения извлеченного сообщения
+ * \param key Ключ, использованный при встраивании
  * \throw std::runtime_error Если файл не может быть открыт
  */
-void cd_extract(const std::string &stego, const std::string &output_file);
+void cd_extract(const std::string &stego, const std::string &output_file, const std::string &key = "");
+
+/**
+ * \brief Вместимость изображения для метода LSB
+ * \param image Путь к изображению-контейнеру
+ * \param bits Количество младших битов на байт канала, от 1 до 4
+ * \return size_t Максимальная длина сообщения в байтах (без завершающего нуля)
+ * \throw std::runtime_error Если заголовок изображения не читается
+ */
+size_t lsb_capacity(const std::string &image, int bits = 1);
+
+/**
+ * \brief Вместимость изображения для метода QIM
+ * \param image Путь к изображению-контейнеру
+ * \return size_t Максимальная длина сообщения в байтах (без завершающего нуля)
+ * \throw std::runtime_error Если заголовок изображения не читается
+ */
+size_t qim_capacity(const std::string &image);
+
+/**
+ * \brief Вместимость изображения для метода CD
+ * \param image Путь к изображению-контейнеру
+ * \return size_t Максимальная длина сообщения в байтах (без завершающего нуля)
+ * \throw std::runtime_error Если заголовок изображения не читается
+ */
+size_t cd_capacity(const std::string &image);
+
+/**
+ * \brief Вместимость LSB для буфера из count байтов каналов (формула lsb_capacity)
+ * \param bits Количество младших битов на байт канала, от 1 до 4
+ * \throw std::runtime_error Если bits вне диапазона 1..4
+ */
+size_t lsb_capacity_pixels(size_t count, int bits = 1);
+
+/**
+ * \brief Вместимость QIM для буфера из count байтов каналов (формула qim_capacity)
+ */
+size_t qim_capacity_pixels(size_t count);
+
+/**
+ * \brief Вместимость CD для буфера из pixel_count пикселей (формула cd_capacity)
+ */
+size_t cd_capacity_pixels(size_t pixel_count);
+
+/**
+ * \brief Встраивает сообщение с завершающим нулём в буфер методом QIM, без файлового ввода-вывода
+ * \param pixels Байты каналов изображения
+ * \param count Количество байтов
+ * \param msg Сообщение, не помещающийся хвост отбрасывается
+ * \param q Параметр квантования
+ * \param key Ключ псевдослучайного рассеивания битов
+ */
+void qim_embed_pixels(unsigned char *pixels, size_t count, const std::string &msg, int q, const std::string &key = "");
+
+/**
+ * \brief Извлекает сообщение QIM из буфера до завершающего нуля
+ */
+std::string qim_extract_pixels(const unsigned char *pixels, size_t count, int q, const std::string &key = "");
+
+/**
+ * \brief Встраивает сообщение с завершающим нулём в буфер методом LSB, без файлового ввода-вывода
+ * \param pixels Байты каналов изображения
+ * \param count Количество байтов
+ * \param msg Сообщение
+ * \param key Ключ псевдослучайного рассеивания битов
+ * \param bits Количество младших битов на байт канала, от 1 до 4
+ * \throw std::runtime_error Если сообщение не помещается
+ */
+void lsb_embed_pixels(unsigned char *pixels, size_t count, const std::string &msg, const std::string &key = "",
+					  int bits = 1);
+
+/**
+ * \brief Извлекает сообщение LSB из буфера до завершающего нуля
+ */
+std::string lsb_extract_pixels(const unsigned char *pixels, size_t count, const std::string &key = "", int bits = 1);
+
+/**
+ * \brief Встраивает сообщение с завершающим нулём в буфер методом CD, без файлового ввода-вывода
+ * \param pixels Пиксели с чередованием каналов, не менее 3 каналов
+ * \param pixel_count Количество пикселей
+ * \param channels Количество каналов
+ * \param msg Сообщение, не помещающийся хвост отбрасывается
+ * \param key Ключ псевдослучайного рассеивания битов
+ */
+void cd_embed_pixels(unsigned char *pixels, size_t pixel_count, int channels, const std::string &msg,
+					 const std::string &key = "");
+
+/**
+ * \brief Извлекает сообщение CD из буфера до завершающего нуля
+ */
+std::string cd_extract_pixels(const unsigned char *pixels, size_t pixel_count, int channels,
+							  const std::string &key = "");
+
+
+/**
+ * \brief Вместимость анимированного GIF для покадрового LSB
+ * \param image Путь к GIF-контейнеру
+ * \param bits Количество младших битов на байт канала, от 1 до 4
+ * \return size_t Максимальная длина сообщения в байтах (без 8-байтового заголовка длины)
+ * \throw std::runtime_error Если GIF не декодируется
+ */
+size_t gif_capacity(const std::string &image, int bits = 1);
+
+/**
+ * \brief Встраивает сообщение в кадры анимированного GIF методом LSB
+ *
+ * Сообщение с 8-байтовым заголовком длины режется по вместимости кадра (каналы R, G, B),
+ * кадры встраиваются и кодируются параллельно. Результат записывается как APNG: палитра
+ * GIF не сохраняет изменённые младшие биты, а APNG хранит кадры без потерь.
+ * \param original Путь к исходному GIF
+ * \param stego Путь для сохранения анимированного PNG (APNG)
+ * \param msg_file Путь к файлу с сообщением
+ * \param bits Количество младших битов на байт канала, от 1 до 4
+ * \throw std::runtime_error Если GIF не декодируется или сообщение не помещается
+ */
+void gif_embed(const std::string &original, const std::string &stego, const std::string &msg_file, int bits = 1);
+
+/**
+ * \brief Извлекает сообщение из APNG, созданного gif_embed, кадры декодируются параллельно
+ * \param stego Путь к APNG
+ * \param output_file Путь для сохранения извлеченного сообщения
+ * \param bits Количество младших битов на байт канала, использованное при встраивании
+ * \throw std::runtime_error Если файл не является APNG или сообщение повреждено
+ */
+void gif_extract(const std::string &stego, const std::string &output_file, int bits = 1);
+
+/**
+ * \brief Читает 32-битное число в сетевом порядке байтов (как в чанках PNG)
+ */
+uint32_t get_be32(const char *in);
 
+/**
+ * \brief Записывает 32-битное число в сетевом порядке байтов (как в чанках PNG)
+ */
+void put_be32(char *out, uint32_t value);
+
+// Kernels
+
+/**
+ * \brief Раскладывает сообщение на k-битовые символы, старшие биты первыми
+ * \param message Сообщение
+ * \param bits Размер символа k в битах
+ * \return Символы по одному на байт, последний дополнен нулями
+ */
+std::vector<unsigned char> unpack_symbols(const std::string &message, int bits);
+
+/**
+ * \brief Собирает байты из k-битовых символов, неполный последний байт отбрасывается
+ * \param symbols Символы по одному на байт
+ * \param count Количество символов
+ * \param bits Размер символа k в битах
+ */
+std::string pack_symbols(const unsigned char *symbols, size_t count, int bits);
+
+/**
+ * \brief Заменяет k младших битов каждого байта символом (SSE2, 16 байт за шаг)
+ * \param meter Если задан, в том же проходе копит SSE, максимум и число изменённых байтов
+ */
+void lsb_insert_bits(unsigned char *pixels, const unsigned char *symbols, size_t count, int bits,
+					 DistortionMeter *meter = nullptr);
+
+/**
+ * \brief Выделяет k младших битов каждого байта (SSE2, 16 байт за шаг)
+ */
+void lsb_collect_bits(const unsigned char *pixels, unsigned char *symbols, size_t count, int bits);
+
+/**
+ * \brief Наибольшая база ячейки QIM, для которой base + step / 2 не превышает 255
+ *
+ * При нечётном или не делящем 256 шаге последняя ячейка короче step / 2 (например, 255 при
+ * q = 3), её значения относятся к ячейке ниже, иначе запись единицы переполняет байт.
+ */
+int qim_top_base(int step);
+
+/**
+ * \brief Встраивает биты QIM: значение заменяется базой ячейки плюс step / 2 для единицы (SSE2, 16 байт за шаг)
+ *
+ * База ячейки - min(step * (v / step), top); деление выполняется 16-битным умножением на
+ * обратное, точным для всех v < 256.
+ * \param top Наибольшая база ячейки, см. qim_top_base
+ * \param meter Учёт искажения или nullptr
+ */
+void qim_insert_bits(unsigned char *pixels, const unsigned char *symbols, size_t count, int step, int top,
+					 DistortionMeter *meter = nullptr);
+
+/**
+ * \brief Читает биты QIM: 1, если значение не ближе к базе ячейки, чем к базе + step / 2 (SSE2)
+ */
+void qim_collect_bits(const unsigned char *pixels, unsigned char *symbols, size_t count, int step, int top);
+
+/**
+ * \brief Добавляет к hist гистограммы значений каждого канала
+ * \param pixels Пиксели с чередованием каналов
+ * \param count Количество пикселей
+ * \param channels Количество каналов
+ * \param hist Массив из channels гистограмм по 256 значений
+ */
+void channel_histograms(const unsigned char *pixels, size_t count, int channels, uint64_t (*hist)[256]);
+
+/**
+ * \brief Помечает байты полосы строк, где отклик Собеля |gx| + |gy| своего канала не меньше порога (SSE2)
+ *
+ * Отклик считается в байтовой арифметике как Собель / 4: веса 1-2-1 - это два
+ * округляющих усреднения, сумма насыщается на 255. Полоса обходится столбцами по
+ * 16 байт сверху вниз, загрузки и горизонтальное сглаживание двух верхних строк
+ * остаются в регистрах. Скалярный хвост повторяет векторную арифметику бит в бит.
+ * \param rows Первая строка полосы; строки rows - row_bytes и rows + count * row_bytes тоже читаются
+ * \param row_bytes Длина строки в байтах
+ * \param count Количество строк полосы
+ * \param step Расстояние до соседа по горизонтали (количество каналов)
+ * \param keep Маска учитываемых битов каждого байта, 0xFF - все биты
+ * \param threshold Порог отклика в единицах Собеля
+ * \param mask Результат count * row_bytes байтов: 1 - текстурный байт, 0 - гладкий; крайние step байтов строк всегда 0
+ */
+void texture_mask_rows(const unsigned char *rows, size_t row_bytes, size_t count, size_t step, unsigned char keep,
+					   int threshold, unsigned char *mask);
 
 // Marlen part
 
@@ -172,6 +904,14 @@ private:
 class ChannelSwapping
 {
 public:
+	/**
+	 * @brief Constructor for class ChannelSwapping.
+	 *
+	 * @param scatter_key Key of pseudo-random pixel order, empty string keeps
+	 * sequential order from the first pixel.
+	 */
+	explicit ChannelSwapping(const std::string &scatter_key = "");
+
 	/**
 	 * @brief Encode function with Channel Swapping algorithm.
 	 *
@@ -192,6 +932,44 @@ public:
 	 */
 	std::string decode(const std::string &img_path, long long int sens_data_size);
 
+	/**
+	 * @brief Capacity of image for Channel Swapping, one bit per pixel.
+	 *
+	 * @param img_path Constant that contains path to input image file.
+	 *
+	 * @return Maximum sensetive data size in bytes.
+	 */
+	long long int capacity(const std::string &img_path) const;
+
+	/**
+	 * @brief Capacity of already decoded pixels, the formula behind capacity().
+	 *
+	 * @param pixel_count Number of pixels.
+	 *
+	 * @return Maximum sensetive data size in bytes.
+	 */
+	static size_t capacity_pixels(size_t pixel_count);
+
+	/**
+	 * @brief Channel Swapping of already decoded pixels, without file I/O.
+	 *
+	 * @param rgb Pixels with 3 interleaved channels, changed in place.
+	 * @param pixel_count Number of pixels.
+	 * @param sens_data Sensetive data to encode.
+	 */
+	void embed(unsigned char *rgb, size_t pixel_count, const std::string &sens_data) const;
+
+	/**
+	 * @brief Reads sens_data_size bytes from already decoded pixels.
+	 *
+	 * @param rgb Pixels with 3 interleaved channels.
+	 * @param pixel_count Number of pixels.
+	 * @param sens_data_size Lenght of data, that was encoded to image.
+	 *
+	 * @return String value that is result of decoding proccess.
+	 */
+	std::string extract(const unsigned char *rgb, size_t pixel_count, size_t sens_data_size) const;
+
 	/**
 	 * @brief Get size of last encoded data
 	 */
@@ -199,6 +977,7 @@ public:
 
 private:
 	long long int last_encoded_size = 0;
+	std::string scatter_key;
 };
 
 /**
@@ -213,6 +992,14 @@ private:
 class MidBitChange
 {
 public:
+	/**
+	 * @brief Constructor for class MidBitChange.
+	 *
+	 * @param scatter_key Key of pseudo-random R/G slot order, empty string keeps
+	 * sequential order from the first pixel.
+	 */
+	explicit MidBitChange(const std::string &scatter_key = "");
+
 	/**
 	 * @brief Encode function with Mid Bit Changing algorithm.
 	 *
@@ -232,6 +1019,48 @@ public:
 	 * @return String value that is result of decoding proccess.
 	 */
 	std::string decode(const std::string &img_path, const size_t sens_data_size);
+
+	/**
+	 * @brief Capacity of image for Mid Bit Changing, two bits (R and G) per
+	 * pixel.
+	 *
+	 * @param img_path Constant that contains path to input image file.
+	 *
+	 * @return Maximum sensetive data size in bytes.
+	 */
+	size_t capacity(const std::string &img_path) const;
+
+	/**
+	 * @brief Capacity of already decoded pixels, the formula behind capacity().
+	 *
+	 * @param pixel_count Number of pixels.
+	 *
+	 * @return Maximum sensetive data size in bytes.
+	 */
+	static size_t capacity_pixels(size_t pixel_count);
+
+	/**
+	 * @brief Mid Bit Changing of already decoded pixels, without file I/O.
+	 *
+	 * @param rgb Pixels with 3 interleaved channels, changed in place.
+	 * @param pixel_count Number of pixels.
+	 * @param sens_data Sensetive data to encode.
+	 */
+	void embed(unsigned char *rgb, size_t pixel_count, const std::string &sens_data) const;
+
+	/**
+	 * @brief Reads sens_data_size bytes from already decoded pixels.
+	 *
+	 * @param rgb Pixels with 3 interleaved channels.
+	 * @param pixel_count Number of pixels.
+	 * @param sens_data_size Lenght of data, that was encoded to image.
+	 *
+	 * @return String value that is result of decoding proccess.
+	 */
+	std::string extract(const unsigned char *rgb, size_t pixel_count, size_t sens_data_size) const;
+
+private:
+	std::string scatter_key;
 };
 
 /**
@@ -243,6 +1072,16 @@ public:
  * @throw FILE_IS_EMPTY - universal Error that appears when image file is empty.
  * @throw SENS_DATA_SIZE_IS_INCCORECT - When sensetive data size is negative or
  * equals zero.
+ * @throw SLOT_DOES_NOT_EXIST - When slot index is out of slot table of
+ * container.
+ * @throw SLOT_CHECKSUM_MISMATCH - When slot data or slot table is damaged.
+ *
+ * Besides single raw blob, file can hold append-only slot container:
+ * [carrier][slot 0][block 0][footer][slot 1][block 1][footer][slot 2][footer]...
+ * Fixed-size footer at the end of file holds slot count and offsets of index
+ * blocks, block b reserves 2^b entries of 24 bytes (offset, length, CRC-32 of
+ * slot, CRC-32 of entry). Slot is read by checking one entry, append writes
+ * one entry into reserved place and one new footer.
  */
 class EOFHiding
 {
@@ -266,7 +1105,362 @@ public:
 	 * @return String data that is result of decoding.
 	 */
 	std::string decode(const std::string &img_path, long long int sens_data_size);
+
+	/**
+	 * @brief Append sensetive data as new slot of container.
+	 *
+	 * @param img_path Path to carrier or existing container file.
+	 * @param sens_data Sensetive data to hide.
+	 * @param output_path Output container path, may be equal to img_path to
+	 * append in place.
+	 *
+	 * @return Index of new slot.
+	 */
+	size_t append_slot(const std::string &img_path, const std::string &sens_data, const std::string &output_path);
+
+	/**
+	 * @brief Read one slot of container.
+	 *
+	 * @param img_path Path to container file.
+	 * @param slot Index of slot.
+	 *
+	 * @return String data of slot.
+	 */
+	std::string read_slot(const std::string &img_path, size_t slot);
+
+	/**
+	 * @brief Number of slots in container, zero for plain carrier.
+	 *
+	 * @param img_path Path to container file.
+	 */
+	size_t slot_count(const std::string &img_path);
 };
 
+/**
+ * @brief PNGChunkHiding is class that realise encode and decode functionality
+ * of hiding data in private ancillary PNG chunk "stEg" placed before IEND.
+ *
+ * Pixels are never decoded: chunks of original file are streamed through
+ * unchanged, so encode and decode cost only file I/O without zlib work. Data
+ * longer than 2^31-1 bytes is split over several stEg chunks.
+ *
+ * @throw FILE_CAN_NOT_BE_OPEN - When input or output file can not be open.
+ * @throw NOT_A_PNG_FILE - When input file has no PNG signature.
+ * @throw CHUNK_IS_DAMAGED - When file is truncated or stEg chunk CRC is wrong.
+ * @throw CHUNK_NOT_FOUND - When decode function finds no stEg chunk.
+ */
+class PNGChunkHiding
+{
+public:
+	/**
+	 * @brief Hidding(encoding) sensetive data in stEg chunk. Previous stEg
+	 * chunks of input file are replaced.
+	 *
+	 * @param img_path Path to original(container) PNG file or "-" for stdin.
+	 * @param sens_data Sensetive data to hide.
+	 * @param output_path Output file path or "-" for stdout.
+	 */
+	void encode(const std::string &img_path, const std::string &sens_data, const std::string &output_path);
+
+	/**
+	 * @brief Taking(decoding) sensetive data from stEg chunks, walking chunk
+	 * headers with seeks.
+	 *
+	 * @param img_path Path to container PNG file or "-" for stdin.
+	 *
+	 * @return String data that is result of decoding.
+	 */
+	std::string decode(const std::string &img_path);
+};
+
+
+// Sharding
+
+/**
+ * \brief Раскладывает большое сообщение по нескольким контейнерам
+ *
+ * Сообщение режется на части по вместимости каждого контейнера (методы cs и mbc,
+ * длина части хранится в индексе), части встраиваются параллельно. Рядом
+ * записывается текстовый индекс: метод, общий размер и для каждой части смещение,
+ * длина, CRC-32 и имя стего-изображения относительно каталога индекса.
+ * \param method Метод встраивания: "cs" или "mbc"
+ * \param msg_file Путь к файлу с сообщением
+ * \param carriers Пути к контейнерам; каталог раскрывается в отсортированный список *.png
+ * \param out_dir Каталог для стего-изображений
+ * \param index_file Путь к файлу индекса
+ * \param key Ключ рассеивания битов внутри каждого контейнера
+ * \throw std::runtime_error Если метод не поддерживается или вместимости не хватает
+ */
+void shard_embed(const std::string &method, const std::string &msg_file, const std::vector<std::string> &carriers,
+				 const std::string &out_dir, const std::string &index_file, const std::string &key = "");
+
+/**
+ * \brief Собирает сообщение из стего-изображений по индексу, части извлекаются параллельно
+ * \param index_file Путь к файлу индекса, созданному shard_embed
+ * \param output_file Путь для сохранения собранного сообщения
+ * \param key Ключ, использованный при встраивании
+ * \throw std::runtime_error Если индекс повреждён или контрольная сумма части не совпала
+ */
+void shard_extract(const std::string &index_file, const std::string &output_file, const std::string &key = "");
+
+// Multiple payloads
+
+/**
+ * \brief Встраивает несколько независимых сообщений в непересекающиеся области носителя за один проход
+ *
+ * В начало носителя (в порядке ScatterOrder) записывается таблица областей: сигнатура
+ * "SMPT", количество сообщений и для каждого длина и CRC-32. Области идут следом
+ * подряд, их начала вычисляются из длин, поэтому таблица не хранит смещений.
+ * Области не пересекаются и заполняются параллельно.
+ * \param pixels Байты каналов носителя
+ * \param count Количество байтов каналов
+ * \param payloads Сообщения
+ * \param method "lsb" (param - бит на канал, 1..4) или "qim" (param - шаг квантования)
+ * \param param Параметр метода
+ * \param key Ключ псевдослучайного рассеивания (пустой - последовательная запись)
+ * \throw std::runtime_error Если метод не поддерживается или сообщения не помещаются
+ */
+void multi_embed_pixels(unsigned char *pixels, size_t count, const std::vector<std::string> &payloads,
+						const std::string &method, int param, const std::string &key = "");
+
+/**
+ * \brief Извлекает одно сообщение по номеру, читая только таблицу и его область
+ * \param index Номер сообщения
+ * \throw std::runtime_error Если таблица повреждена, номера нет или CRC-32 не совпал
+ */
+std::string multi_extract_pixels(const unsigned char *pixels, size_t count, size_t index, const std::string &method,
+								 int param, const std::string &key = "");
+
+/**
+ * \brief Встраивает сообщения из файлов в изображение: одно декодирование, один проход, одно кодирование
+ * \param method "lsb" или "qim"
+ * \param original Путь к исходному изображению
+ * \param stego Путь для сохранения стего-изображения
+ * \param msg_files Пути к файлам сообщений, порядок задаёт номера
+ * \param param Бит на канал для lsb или шаг квантования для qim
+ * \param key Ключ рассеивания
+ */
+void multi_embed(const std::string &method, const std::string &original, const std::string &stego,
+				 const std::vector<std::string> &msg_files, int param, const std::string &key = "");
+
+/**
+ * \brief Извлекает сообщение с номером index из стего-изображения
+ */
+std::string multi_extract(const std::string &method, const std::string &stego, size_t index, int param,
+						  const std::string &key = "");
+
+// Adaptive embedding
+
+/**
+ * \brief Вместимость адаптивного встраивания в байтах без завершающего нуля
+ *
+ * Данные пишутся только в текстурные байты: отклик Собеля |gx| + |gy| по своему
+ * каналу не меньше threshold (см. texture_mask_rows). Карта строится одним параллельным
+ * проходом по полосам строк только из битов, которые метод не меняет (v с обнулёнными k
+ * младшими битами для lsb, ячейка v / q для qim, v без младшего бита для cd), поэтому
+ * при извлечении она восстанавливается из стего-изображения без параметров.
+ * Альфа-канал и крайние строки и столбцы не используются. Для cd слот - пиксель, у
+ * которого текстурный канал, выбранный по тем же устойчивым битам.
+ * \param method "lsb", "qim" или "cd"
+ * \param param Бит на канал для lsb, шаг квантования для qim, для cd не используется
+ * \param threshold Порог отклика Собеля, 0 - все внутренние пиксели
+ */
+size_t adaptive_capacity(const unsigned char *pixels, int width, int height, int channels,
+						 const std::string &method, int param, int threshold);
+
+/**
+ * \brief Адаптивная вместимость изображения в байтах (параметры как у adaptive_capacity для буфера)
+ * \throw std::runtime_error Если изображение не читается или метод не поддерживается
+ */
+size_t adaptive_capacity(const std::string &method, const std::string &image, int param, int threshold);
+
+/**
+ * \brief Текстурные слоты контейнера: прогоны подряд идущих слотов вдоль строк
+ *
+ * Встраивание не меняет биты, из которых строится карта, поэтому карта исходного
+ * контейнера подходит и для проверки, и для извлечения из стего-изображения того же
+ * размера без повторного прохода.
+ */
+struct AdaptiveMap
+{
+	struct Run
+	{
+		size_t first;  // байтовая позиция первого слота
+		size_t length; // количество слотов
+	};
+
+	std::string method;
+	int param = 0;
+	int threshold = 0;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<Run> runs;
+	std::vector<size_t> starts; // номер первого слота каждого прогона
+	size_t stride = 1;			// байтов между слотами прогона: 1 для lsb и qim, каналов для cd
+	size_t total = 0;			// всего слотов
+};
+
+/**
+ * \brief Строит карту текстурных слотов (параметры как у adaptive_capacity)
+ * \throw std::runtime_error Если метод или параметр не поддерживается
+ */
+AdaptiveMap adaptive_map(const unsigned char *pixels, int width, int height, int channels, const std::string &method,
+						 int param, int threshold);
+
+/**
+ * \brief Встраивает сообщение с завершающим нулём в слоты готовой карты
+ * \throw std::runtime_error Если сообщение не помещается
+ */
+void adaptive_embed_pixels(unsigned char *pixels, const AdaptiveMap &map, const std::string &msg,
+						   const std::string &key = "");
+
+/**
+ * \brief Извлекает сообщение до завершающего нуля из слотов готовой карты
+ */
+std::string adaptive_extract_pixels(const unsigned char *pixels, const AdaptiveMap &map, const std::string &key = "");
+
+/**
+ * \brief Встраивает сообщение с завершающим нулём только в текстурные байты
+ * \throw std::runtime_error Если метод не поддерживается или сообщение не помещается
+ */
+void adaptive_embed_pixels(unsigned char *pixels, int width, int height, int channels, const std::string &msg,
+						   const std::string &method, int param, int threshold, const std::string &key = "");
+
+/**
+ * \brief Извлекает адаптивно встроенное сообщение до завершающего нуля
+ */
+std::string adaptive_extract_pixels(const unsigned char *pixels, int width, int height, int channels,
+									const std::string &method, int param, int threshold, const std::string &key = "");
+
+/**
+ * \brief Адаптивно встраивает сообщение из файла в изображение
+ */
+void adaptive_embed(const std::string &method, const std::string &original, const std::string &stego,
+					const std::string &msg_file, int param, int threshold, const std::string &key = "");
+
+/**
+ * \brief Извлекает адаптивно встроенное сообщение из изображения в файл
+ */
+void adaptive_extract(const std::string &method, const std::string &stego, const std::string &output_file, int param,
+					  int threshold, const std::string &key = "");
+
+
+// Automatic method selection
+
+/**
+ * \brief Метод, выбранный автоматически для контейнера и сообщения
+ */
+struct AutoChoice
+{
+	int id;			 // номер метода в заголовке: 1 lsb, 2 qim, 3 cd, 4 cs, 5 mbc
+	int param;		 // бит на канал для lsb, шаг q для qim, иначе 0
+	double cost;	 // оценка времени по модели пропускной способности, условные единицы
+	double psnr;	 // PSNR пробного встраивания в дБ, 0 если порог не задан
+};
+
+/**
+ * \brief Загружает модель пропускной способности методов из JSON stego_bench --update
+ *
+ * Из файла берутся относительные скорости "lsb", "lsb b=2" .. "lsb b=4", "qim q=4",
+ * "cd", "cs" и "mbc". Пустой путь возвращает встроенную модель: perf_baseline.json
+ * дерева исходников, который сборка вкладывает в программу. Встроенная модель разбирается
+ * при первом выборе метода, и отсутствие в ней метода - ошибка этого выбора.
+ * \throw std::runtime_error Если файл не читается или в нём нет нужного метода
+ */
+void auto_model_load(const std::string &path);
+
+/**
+ * \brief Методы, в которые помещается сообщение, от самого быстрого по модели
+ *
+ * Стоимость - доля вместимости, которую займёт сообщение, умноженная на время полного
+ * прохода по контейнеру со скоростью метода. lsb, qim и cd не переносят нулевые байты,
+ * cs и mbc работают только с RGB. eof и chunk не рассматриваются: они не меняют пиксели,
+ * заголовок выбора для них записать некуда.
+ * \param bits Бит на канал для кандидата lsb
+ */
+std::vector<AutoChoice> auto_candidates(int width, int height, int channels, const std::string &msg, int bits = 1);
+
+/**
+ * \brief Имя выбранного метода с параметром, например "lsb 1" или "cs"
+ */
+std::string auto_choice_name(const AutoChoice &choice);
+
+/**
+ * \brief Встраивает сообщение самым быстрым подходящим методом
+ *
+ * В младшие биты первых 112 байтов каналов пишется заголовок: "SAUT", метод, параметр,
+ * длина и CRC-32 сообщения; остальные пиксели получает выбранный метод. Кандидаты
+ * пробуются по порядку на копии, и выбирается первый, из которого сообщение читается
+ * обратно (cd и cs справляются не с каждым контейнером), а при заданном min_psnr ещё и
+ * PSNR всего контейнера не ниже порога.
+ * \param min_psnr Нижняя граница PSNR в дБ, 0 - без ограничения
+ * \throw std::runtime_error Если сообщение не помещается ни одним методом или в пределах PSNR
+ */
+AutoChoice auto_embed_pixels(unsigned char *pixels, int width, int height, int channels, const std::string &msg,
+							 double min_psnr = 0, const std::string &key = "", int bits = 1);
+
+/**
+ * \brief Извлекает сообщение по заголовку, без указания метода и параметров
+ * \throw std::runtime_error Если заголовка нет или сообщение не сходится с CRC-32
+ */
+std::string auto_extract_pixels(const unsigned char *pixels, int width, int height, int channels,
+								const std::string &key = "");
+
+/**
+ * \brief Встраивает сообщение из файла автоматически выбранным методом
+ * \return Выбранный метод
+ */
+AutoChoice auto_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
+					  double min_psnr = 0, const std::string &key = "", int bits = 1);
+
+/**
+ * \brief Извлекает автоматически встроенное сообщение из изображения в файл
+ */
+void auto_extract(const std::string &stego, const std::string &output_file, const std::string &key = "");
+
+
+// Steganalysis
+
+/**
+ * \brief Результат стегоанализа одного изображения
+ */
+struct StegAnalysis
+{
+	std::string image;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<std::vector<uint64_t>> histograms; // гистограммы значений по каналам
+	double chi_square_p = 0;					   // вероятность выравнивания пар значений (тест хи-квадрат)
+	double chi_square_rate = 0;					   // доля строк от начала, где тест хи-квадрат срабатывает
+	double rs_rate = 0;							   // оценка доли изменённых LSB по RS-анализу
+	double estimated_rate = 0;					   // итоговая оценка заполненности LSB
+};
+
+/**
+ * \brief Анализирует изображение тестом хи-квадрат и RS-анализом
+ *
+ * Изображение делится на горизонтальные полосы, которые обрабатываются параллельно.
+ * \param path Путь к изображению или "-"
+ * \param threads Количество потоков, 0 - по числу ядер
+ * \return StegAnalysis Статистика изображения
+ * \throw std::runtime_error Если изображение не загружается
+ */
+StegAnalysis analyze_image(const std::string &path, unsigned threads = 0);
+
+/**
+ * \brief Анализирует набор изображений, изображения распределяются по потокам
+ * \param paths Пути к изображениям; каталог раскрывается в отсортированный список *.png
+ * \param threads Количество потоков, 0 - по числу ядер
+ * \return std::vector<StegAnalysis> Результаты в порядке путей
+ */
+std::vector<StegAnalysis> analyze_images(const std::vector<std::string> &paths, unsigned threads = 0);
+
+/**
+ * \brief Сериализует результат анализа в однострочный JSON
+ */
+std::string analysis_to_json(const StegAnalysis &analysis);
+
 
-#endif
\ No newline at end of file
+#endif
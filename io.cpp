@@ -0,0 +1,312 @@
+#include "headers.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+void write_to_stdout(void *context, void *data, int size)
+{
+    (void)context;
+    fwrite(data, 1, static_cast<size_t>(size), stdout);
+    stats_add(BYTES_WRITTEN, static_cast<uint64_t>(size));
+}
+} // namespace
+
+unsigned char *load_image(const std::string &path, int *width, int *height, int *channels, int desired_channels)
+{
+    if (path != "-")
+    {
+        PhaseTimer timer(PHASE_DECODE);
+        if (unsigned char *cached = carrier_cache_load(path, width, height, channels, desired_channels))
+            return cached;
+        if (stats_enabled())
+        {
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(path, ec);
+            stats_add(BYTES_READ, ec ? 0 : static_cast<uint64_t>(size));
+        }
+        unsigned char *data = nullptr;
+        try
+        {
+            MappedFile file(path);
+            data = png_decode(reinterpret_cast<const unsigned char *>(file.data()), file.size(), width, height,
+                              channels, desired_channels);
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+        if (!data)
+            data = stbi_load(path.c_str(), width, height, channels, desired_channels);
+        carrier_cache_store(path, data, *width, *height, *channels, desired_channels);
+        return data;
+    }
+
+    const std::string buffer = read_file_to_string(path);
+    PhaseTimer timer(PHASE_DECODE);
+    if (unsigned char *data = png_decode(reinterpret_cast<const unsigned char *>(buffer.data()), buffer.size(), width,
+                                         height, channels, desired_channels))
+        return data;
+    return stbi_load_from_memory(reinterpret_cast<const stbi_uc *>(buffer.data()), static_cast<int>(buffer.size()),
+                                 width, height, channels, desired_channels);
+}
+
+bool image_info(const std::string &path, int *width, int *height, int *channels)
+{
+    if (path != "-")
+        return stbi_info(path.c_str(), width, height, channels) != 0;
+
+    const std::string buffer = read_file_to_string(path);
+    return stbi_info_from_memory(reinterpret_cast<const stbi_uc *>(buffer.data()), static_cast<int>(buffer.size()),
+                                 width, height, channels) != 0;
+}
+
+bool write_image(const std::string &path, int width, int height, int channels, const unsigned char *data)
+{
+    PhaseTimer timer(PHASE_ENCODE);
+    if (path != "-")
+    {
+        const bool ok = stbi_write_png(path.c_str(), width, height, channels, data, width * channels) != 0;
+        if (ok && stats_enabled())
+        {
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(path, ec);
+            stats_add(BYTES_WRITTEN, ec ? 0 : static_cast<uint64_t>(size));
+        }
+        return ok;
+    }
+
+    bool ok = stbi_write_png_to_func(write_to_stdout, nullptr, width, height, channels, data, width * channels) != 0;
+    fflush(stdout);
+    return ok;
+}
+
+void write_file(const std::string &path, const std::string &data)
+{
+    PhaseTimer timer(PHASE_WRITE);
+    stats_add(BYTES_WRITTEN, data.size());
+    if (path == "-")
+    {
+        std::cout.write(data.data(), data.size());
+        std::cout.flush();
+        return;
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open())
+    {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    out.write(data.data(), data.size());
+}
+
+MappedFile::MappedFile(const std::string &path)
+{
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0)
+        {
+            void *map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED)
+            {
+                mapping = map;
+                bytes = static_cast<const char *>(map);
+                madvise(map, length, MADV_SEQUENTIAL);
+            }
+        }
+    }
+
+    if (!mapping)
+    {
+        // Pipes, character devices and failed mappings are read into a buffer
+        char chunk[65536];
+        ssize_t n;
+        while ((n = read(fd, chunk, sizeof(chunk))) != 0)
+        {
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+            {
+                close(fd);
+                throw std::runtime_error("Failed to read file: " + path);
+            }
+            buffer.insert(buffer.end(), chunk, chunk + n);
+        }
+        bytes = buffer.data();
+        length = buffer.size();
+    }
+    close(fd);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    bytes = buffer.data();
+    length = buffer.size();
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(__linux__)
+    if (mapping)
+        munmap(mapping, length);
+#endif
+}
+
+const char *MappedFile::data() const
+{
+    return bytes;
+}
+
+size_t MappedFile::size() const
+{
+    return length;
+}
+
+void copy_file_contents(const std::string &src, const std::string &dst)
+{
+    PhaseTimer timer(PHASE_WRITE);
+#if defined(__linux__)
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + src);
+    }
+    struct stat st;
+    if (fstat(in, &st) != 0)
+    {
+        close(in);
+        throw std::runtime_error("Failed to read file: " + src);
+    }
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0)
+    {
+        close(in);
+        throw std::runtime_error("Failed to open file: " + dst);
+    }
+
+    const off_t total = st.st_size;
+    off_t copied = 0;
+#ifdef FICLONE
+    // Reflink shares extents on btrfs/xfs/bcachefs, no data is copied at all
+    if (S_ISREG(st.st_mode) && ioctl(out, FICLONE, in) == 0)
+        copied = total;
+#endif
+
+    bool use_copy_range = true, use_sendfile = true;
+    std::vector<char> chunk;
+    while (copied < total)
+    {
+        const size_t remaining = static_cast<size_t>(std::min<off_t>(total - copied, 1 << 30));
+        ssize_t n;
+        if (use_copy_range)
+        {
+            n = copy_file_range(in, nullptr, out, nullptr, remaining, 0);
+            if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+            {
+                use_copy_range = false;
+                continue;
+            }
+        }
+        else if (use_sendfile)
+        {
+            n = sendfile(out, in, nullptr, remaining);
+            if (n < 0 && (errno == ENOSYS || errno == EINVAL))
+            {
+                use_sendfile = false;
+                continue;
+            }
+        }
+        else
+        {
+            chunk.resize(1 << 20);
+            n = read(in, chunk.data(), std::min(chunk.size(), remaining));
+            for (ssize_t written = 0; n > 0 && written < n;)
+            {
+                ssize_t w = write(out, chunk.data() + written, n - written);
+                if (w < 0 && errno != EINTR)
+                {
+                    n = -1;
+                    break;
+                }
+                written += std::max<ssize_t>(w, 0);
+            }
+        }
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            close(in);
+            close(out);
+            throw std::runtime_error("Failed to copy file: " + src);
+        }
+        if (n == 0)
+            break;
+        copied += n;
+    }
+    stats_add(BYTES_READ, static_cast<uint64_t>(copied));
+    stats_add(BYTES_WRITTEN, static_cast<uint64_t>(copied));
+    close(in);
+    if (close(out) != 0)
+    {
+        throw std::runtime_error("Failed to write file: " + dst);
+    }
+#else
+    std::ifstream in(src, std::ios::binary);
+    if (!in.is_open())
+    {
+        throw std::runtime_error("Failed to open file: " + src);
+    }
+    std::ofstream out(dst, std::ios::binary);
+    if (!out.is_open())
+    {
+        throw std::runtime_error("Failed to open file: " + dst);
+    }
+    out << in.rdbuf();
+    stats_add(BYTES_WRITTEN, static_cast<uint64_t>(out.tellp()));
+#endif
+}
+
+std::vector<std::string> expand_image_paths(const std::vector<std::string> &paths)
+{
+    namespace fs = std::filesystem;
+    std::vector<std::string> result;
+    for (const auto &path : paths)
+    {
+        if (!fs::is_directory(path))
+        {
+            result.push_back(path);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto &entry : fs::directory_iterator(path))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".png")
+                found.push_back(entry.path().string());
+        }
+        std::sort(found.begin(), found.end());
+        result.insert(result.end(), found.begin(), found.end());
+    }
+    return result;
+}
@@ -0,0 +1,452 @@
+#include "headers.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+template <int K> void unpack_fixed(const std::string &message, unsigned char *symbols)
+{
+    constexpr int per_byte = 8 / K;
+    constexpr unsigned mask = (1u << K) - 1;
+    for (size_t i = 0; i < message.size(); ++i)
+    {
+        const unsigned c = static_cast<unsigned char>(message[i]);
+        for (int j = 0; j < per_byte; ++j)
+            symbols[i * per_byte + j] = static_cast<unsigned char>((c >> (8 - K * (j + 1))) & mask);
+    }
+}
+
+template <int K> void pack_fixed(const unsigned char *symbols, size_t bytes, std::string &out)
+{
+    constexpr int per_byte = 8 / K;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        unsigned c = 0;
+        for (int j = 0; j < per_byte; ++j)
+            c = (c << K) | symbols[i * per_byte + j];
+        out[i] = static_cast<char>(c);
+    }
+}
+
+template <> void pack_fixed<1>(const unsigned char *symbols, size_t bytes, std::string &out)
+{
+    // Eight 0/1 bytes are gathered into one byte by a single multiply, byte 0 lands in the MSB
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        uint64_t v;
+        std::memcpy(&v, symbols + i * 8, 8);
+        out[i] = static_cast<char>((v * 0x8040201008040201ULL) >> 56);
+    }
+}
+
+// Three bytes hold exactly eight 3-bit symbols, so k = 3 works on whole 24-bit groups
+void unpack_triples(const std::string &message, unsigned char *symbols)
+{
+    for (size_t g = 0; g + 3 <= message.size(); g += 3)
+    {
+        const uint32_t v = static_cast<unsigned char>(message[g]) << 16 | static_cast<unsigned char>(message[g + 1]) << 8 |
+                           static_cast<unsigned char>(message[g + 2]);
+        unsigned char *out = symbols + g / 3 * 8;
+        for (int j = 0; j < 8; ++j)
+            out[j] = static_cast<unsigned char>((v >> (21 - 3 * j)) & 7);
+    }
+}
+
+void pack_triples(const unsigned char *symbols, size_t bytes, std::string &out)
+{
+    for (size_t g = 0; g + 3 <= bytes; g += 3)
+    {
+        const unsigned char *in = symbols + g / 3 * 8;
+        uint32_t v = 0;
+        for (int j = 0; j < 8; ++j)
+            v = (v << 3) | in[j];
+        out[g] = static_cast<char>(v >> 16);
+        out[g + 1] = static_cast<char>(v >> 8);
+        out[g + 2] = static_cast<char>(v);
+    }
+}
+
+// Bit-at-a-time fallback from the first symbol or byte a fixed-size path has not covered
+void unpack_generic(const std::string &message, int bits, std::vector<unsigned char> &symbols, size_t first)
+{
+    const size_t total_bits = message.size() * 8;
+    for (size_t s = first; s < symbols.size(); ++s)
+    {
+        unsigned value = 0;
+        for (int b = 0; b < bits; ++b)
+        {
+            const size_t bit = s * bits + b;
+            const unsigned v = bit < total_bits ? (static_cast<unsigned char>(message[bit / 8]) >> (7 - bit % 8)) & 1 : 0;
+            value = (value << 1) | v;
+        }
+        symbols[s] = static_cast<unsigned char>(value);
+    }
+}
+
+void pack_generic(const unsigned char *symbols, int bits, std::string &out, size_t first)
+{
+    for (size_t byte = first; byte < out.size(); ++byte)
+    {
+        unsigned value = 0;
+        for (int b = 0; b < 8; ++b)
+        {
+            const size_t bit = byte * 8 + b;
+            value = (value << 1) | ((symbols[bit / bits] >> (bits - 1 - bit % bits)) & 1);
+        }
+        out[byte] = static_cast<char>(value);
+    }
+}
+
+#if defined(__SSE2__)
+// Distortion of replaced 16-byte blocks kept in vector lanes and folded into the meter once per span
+class VectorDistortion
+{
+public:
+    void add(__m128i before, __m128i after)
+    {
+        // |a - b| from two saturating subtractions, squares summed pairwise by madd into 32-bit lanes
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i diff = _mm_or_si128(_mm_subs_epu8(before, after), _mm_subs_epu8(after, before));
+        max_acc = _mm_max_epu8(max_acc, diff);
+        changed += 16 - __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero)));
+        const __m128i lo = _mm_unpacklo_epi8(diff, zero), hi = _mm_unpackhi_epi8(diff, zero);
+        const __m128i squares = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+        sse_acc = _mm_add_epi64(sse_acc,
+                                _mm_add_epi64(_mm_unpacklo_epi32(squares, zero), _mm_unpackhi_epi32(squares, zero)));
+    }
+
+    void fold(uint64_t &sse, uint64_t &changed_total, unsigned &max_delta) const
+    {
+        alignas(16) uint64_t lanes[2];
+        alignas(16) unsigned char maxima[16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sse_acc);
+        _mm_store_si128(reinterpret_cast<__m128i *>(maxima), max_acc);
+        sse += lanes[0] + lanes[1];
+        changed_total += changed;
+        max_delta = std::max(max_delta, static_cast<unsigned>(*std::max_element(maxima, maxima + 16)));
+    }
+
+private:
+    __m128i sse_acc = _mm_setzero_si128();
+    __m128i max_acc = _mm_setzero_si128();
+    uint64_t changed = 0;
+};
+#endif
+
+inline void record_scalar(int before, int after, uint64_t &sse, uint64_t &changed, unsigned &max_delta)
+{
+    const int delta = after - before;
+    sse += static_cast<uint64_t>(delta * delta);
+    changed += delta != 0;
+    max_delta = std::max(max_delta, static_cast<unsigned>(std::abs(delta)));
+}
+
+template <bool Measure>
+void insert_bits(unsigned char *pixels, const unsigned char *symbols, size_t count, int bits, DistortionMeter *meter)
+{
+    const unsigned char keep = static_cast<unsigned char>(0xFF << bits);
+    size_t i = 0;
+    uint64_t sse = 0, changed = 0;
+    unsigned max_delta = 0;
+#if defined(__SSE2__)
+    const __m128i keep_mask = _mm_set1_epi8(static_cast<char>(keep));
+    VectorDistortion distortion;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+        __m128i sym = _mm_loadu_si128(reinterpret_cast<const __m128i *>(symbols + i));
+        __m128i out = _mm_or_si128(_mm_and_si128(px, keep_mask), sym);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), out);
+        if (Measure)
+            distortion.add(px, out);
+    }
+    if (Measure)
+        distortion.fold(sse, changed, max_delta);
+#endif
+    for (; i < count; ++i)
+    {
+        const int before = pixels[i];
+        pixels[i] = static_cast<unsigned char>((before & keep) | symbols[i]);
+        if (Measure)
+            record_scalar(before, pixels[i], sse, changed, max_delta);
+    }
+    if (Measure)
+        meter->add(sse, changed, max_delta);
+}
+
+#if defined(__SSE2__)
+// Cell bases of 16 bytes: v / step by a 16-bit multiply-high, exact for v < 256 and step <= 256
+class VectorCells
+{
+public:
+    VectorCells(int step, int top)
+        : magic(_mm_set1_epi16(static_cast<short>((65536 + step - 1) / step))), step_vec(_mm_set1_epi16(step)),
+          top_vec(_mm_set1_epi16(top))
+    {
+    }
+
+    __m128i bases(__m128i px) const
+    {
+        const __m128i zero = _mm_setzero_si128();
+        return _mm_packus_epi16(half_bases(_mm_unpacklo_epi8(px, zero)), half_bases(_mm_unpackhi_epi8(px, zero)));
+    }
+
+private:
+    __m128i half_bases(__m128i v) const
+    {
+        return _mm_min_epi16(_mm_mullo_epi16(_mm_mulhi_epu16(v, magic), step_vec), top_vec);
+    }
+
+    __m128i magic, step_vec, top_vec;
+};
+#endif
+
+template <bool Measure>
+void insert_cells(unsigned char *pixels, const unsigned char *symbols, size_t count, int step, int top,
+                  DistortionMeter *meter)
+{
+    const int half = step / 2;
+    size_t i = 0;
+    uint64_t sse = 0, changed = 0;
+    unsigned max_delta = 0;
+#if defined(__SSE2__)
+    if (step <= 255)
+    {
+        const VectorCells cells(step, top);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i half_vec = _mm_set1_epi8(static_cast<char>(half));
+        VectorDistortion distortion;
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+            const __m128i sym = _mm_loadu_si128(reinterpret_cast<const __m128i *>(symbols + i));
+            const __m128i out = _mm_add_epi8(cells.bases(px), _mm_andnot_si128(_mm_cmpeq_epi8(sym, zero), half_vec));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), out);
+            if (Measure)
+                distortion.add(px, out);
+        }
+        if (Measure)
+            distortion.fold(sse, changed, max_delta);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const int before = pixels[i];
+        pixels[i] = static_cast<unsigned char>(std::min(before / step * step, top) + half * symbols[i]);
+        if (Measure)
+            record_scalar(before, pixels[i], sse, changed, max_delta);
+    }
+    if (Measure)
+        meter->add(sse, changed, max_delta);
+}
+} // namespace
+
+std::vector<unsigned char> unpack_symbols(const std::string &message, int bits)
+{
+    const size_t total_bits = message.size() * 8;
+    std::vector<unsigned char> symbols((total_bits + bits - 1) / bits);
+    switch (bits)
+    {
+    case 1:
+        unpack_fixed<1>(message, symbols.data());
+        break;
+    case 2:
+        unpack_fixed<2>(message, symbols.data());
+        break;
+    case 3:
+        unpack_triples(message, symbols.data());
+        unpack_generic(message, bits, symbols, message.size() / 3 * 8);
+        break;
+    case 4:
+        unpack_fixed<4>(message, symbols.data());
+        break;
+    default:
+        unpack_generic(message, bits, symbols, 0);
+    }
+    return symbols;
+}
+
+std::string pack_symbols(const unsigned char *symbols, size_t count, int bits)
+{
+    std::string out(count * bits / 8, '\0');
+    switch (bits)
+    {
+    case 1:
+        pack_fixed<1>(symbols, out.size(), out);
+        break;
+    case 2:
+        pack_fixed<2>(symbols, out.size(), out);
+        break;
+    case 3:
+        pack_triples(symbols, out.size(), out);
+        pack_generic(symbols, bits, out, out.size() / 3 * 3);
+        break;
+    case 4:
+        pack_fixed<4>(symbols, out.size(), out);
+        break;
+    default:
+        pack_generic(symbols, bits, out, 0);
+    }
+    return out;
+}
+
+void lsb_insert_bits(unsigned char *pixels, const unsigned char *symbols, size_t count, int bits,
+                     DistortionMeter *meter)
+{
+    if (meter)
+        insert_bits<true>(pixels, symbols, count, bits, meter);
+    else
+        insert_bits<false>(pixels, symbols, count, bits, nullptr);
+}
+
+void lsb_collect_bits(const unsigned char *pixels, unsigned char *symbols, size_t count, int bits)
+{
+    const unsigned char mask = static_cast<unsigned char>((1u << bits) - 1);
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i low_mask = _mm_set1_epi8(static_cast<char>(mask));
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(symbols + i), _mm_and_si128(px, low_mask));
+    }
+#endif
+    for (; i < count; ++i)
+        symbols[i] = static_cast<unsigned char>(pixels[i] & mask);
+}
+
+int qim_top_base(int step)
+{
+    const int top = 255 / step * step;
+    return top + step / 2 > 255 ? top - step : top;
+}
+
+void qim_insert_bits(unsigned char *pixels, const unsigned char *symbols, size_t count, int step, int top,
+                     DistortionMeter *meter)
+{
+    if (meter)
+        insert_cells<true>(pixels, symbols, count, step, top, meter);
+    else
+        insert_cells<false>(pixels, symbols, count, step, top, nullptr);
+}
+
+void qim_collect_bits(const unsigned char *pixels, unsigned char *symbols, size_t count, int step, int top)
+{
+    // A value reads as 1 when it is at least as close to base + step / 2 as to base, that is 2 (v - base) >= step / 2
+    const int threshold = (step / 2 + 1) / 2;
+    size_t i = 0;
+#if defined(__SSE2__)
+    if (step <= 255)
+    {
+        const VectorCells cells(step, top);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi8(1);
+        const __m128i threshold_vec = _mm_set1_epi8(static_cast<char>(threshold));
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+            const __m128i offset = _mm_subs_epu8(px, cells.bases(px));
+            const __m128i hit = _mm_cmpeq_epi8(_mm_subs_epu8(threshold_vec, offset), zero);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(symbols + i), _mm_and_si128(hit, one));
+        }
+    }
+#endif
+    for (; i < count; ++i)
+        symbols[i] = pixels[i] - std::min(pixels[i] / step * step, top) >= threshold ? 1 : 0;
+}
+
+void channel_histograms(const unsigned char *pixels, size_t count, int channels, uint64_t (*hist)[256])
+{
+    // Byte histograms do not map to vector lanes; four replicated counter tables break the
+    // store-to-load dependency on repeated values, which is what limits a naive loop
+    std::vector<uint32_t> lanes(4 * static_cast<size_t>(channels) * 256, 0);
+    const size_t group = 4 * static_cast<size_t>(channels);
+    size_t i = 0;
+    for (; i + group <= count * channels; i += group)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            uint32_t *table = &lanes[static_cast<size_t>(lane) * channels * 256];
+            for (int c = 0; c < channels; ++c)
+                ++table[c * 256 + pixels[i + lane * channels + c]];
+        }
+    }
+    for (; i < count * channels; ++i)
+        ++lanes[(i % channels) * 256 + pixels[i]];
+
+    for (int lane = 0; lane < 4; ++lane)
+        for (int c = 0; c < channels; ++c)
+            for (int v = 0; v < 256; ++v)
+                hist[c][v] += lanes[(static_cast<size_t>(lane) * channels + c) * 256 + v];
+}
+
+void texture_mask_rows(const unsigned char *rows, size_t row_bytes, size_t count, size_t step, unsigned char keep,
+                       int threshold, unsigned char *mask)
+{
+    const int limit = (std::max(threshold, 0) + 3) / 4;
+    if (row_bytes <= 2 * step || limit > 255)
+    {
+        std::fill(mask, mask + count * row_bytes, 0);
+        return;
+    }
+    for (size_t y = 0; y < count; ++y)
+    {
+        std::fill(mask + y * row_bytes, mask + y * row_bytes + step, 0);
+        std::fill(mask + (y + 1) * row_bytes - step, mask + (y + 1) * row_bytes, 0);
+    }
+    size_t x = step;
+#if defined(__SSE2__)
+    // Sobel / 4 in bytes: the 1-2-1 taps are two rounding averages, so 16 responses need no widening.
+    // Strips of 16 columns walk down the band, the rows above keep their loads and horizontal smoothing in registers.
+    const __m128i limit_vec = _mm_set1_epi8(static_cast<char>(limit));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i keep_vec = _mm_set1_epi8(static_cast<char>(keep));
+    auto load = [keep_vec](const unsigned char *p) {
+        return _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), keep_vec);
+    };
+    auto absdiff = [](__m128i a, __m128i b) { return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)); };
+    for (; x + step + 16 <= row_bytes; x += 16)
+    {
+        const unsigned char *p = rows - row_bytes + x;
+        __m128i al = load(p - step), ar = load(p + step);
+        __m128i ha = _mm_avg_epu8(_mm_avg_epu8(al, ar), load(p));
+        p += row_bytes;
+        __m128i rl = load(p - step), rr = load(p + step);
+        __m128i hr = _mm_avg_epu8(_mm_avg_epu8(rl, rr), load(p));
+        unsigned char *out = mask + x;
+        for (size_t y = 0; y < count; ++y, out += row_bytes)
+        {
+            p += row_bytes;
+            const __m128i bl = load(p - step), br = load(p + step);
+            const __m128i hb = _mm_avg_epu8(_mm_avg_epu8(bl, br), load(p));
+            const __m128i gx = absdiff(_mm_avg_epu8(_mm_avg_epu8(ar, br), rr), _mm_avg_epu8(_mm_avg_epu8(al, bl), rl));
+            const __m128i gy = absdiff(hb, ha);
+            const __m128i hit = _mm_cmpeq_epi8(_mm_subs_epu8(limit_vec, _mm_adds_epu8(gx, gy)), zero);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_and_si128(hit, one));
+            al = rl;
+            ar = rr;
+            ha = hr;
+            rl = bl;
+            rr = br;
+            hr = hb;
+        }
+    }
+#endif
+    auto avg = [](int a, int b) { return (a + b + 1) >> 1; };
+    for (size_t y = 0; y < count; ++y)
+    {
+        const unsigned char *row = rows + y * row_bytes, *above = row - row_bytes, *below = row + row_bytes;
+        for (size_t i = x; i + step < row_bytes; ++i)
+        {
+            const int al = above[i - step] & keep, ac = above[i] & keep, ar = above[i + step] & keep;
+            const int rl = row[i - step] & keep, rr = row[i + step] & keep;
+            const int bl = below[i - step] & keep, bc = below[i] & keep, br = below[i + step] & keep;
+            const int gx = std::abs(avg(avg(ar, br), rr) - avg(avg(al, bl), rl));
+            const int gy = std::abs(avg(avg(bl, br), bc) - avg(avg(al, ar), ac));
+            mask[y * row_bytes + i] = std::min(gx + gy, 255) >= limit ? 1 : 0;
+        }
+    }
+}
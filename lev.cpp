@@ -6,320 +6,402 @@ ImageData::ImageData()
 
 std::string read_file_to_string(const std::string &file_path)
 {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file.is_open())
+    PhaseTimer timer(PHASE_READ);
+    if (file_path == "-")
     {
-        throw std::runtime_error("Failed to open file: " + file_path);
+        std::stringstream buffer;
+        buffer << std::cin.rdbuf();
+        stats_add(BYTES_READ, buffer.str().size());
+        return buffer.str();
     }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string content = buffer.str();
-    return content;
+
+    MappedFile file(file_path);
+    stats_add(BYTES_READ, file.size());
+    return std::string(file.data(), file.size());
 }
 
-void qim_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
-               const std::string &q_str)
+uint32_t crc32(const char *data, size_t size, uint32_t crc)
 {
-    ImageData img;
-    img.data = stbi_load(original.c_str(), &img.width, &img.height, &img.channels, 0);
-    if (!img.data)
+    static uint32_t table[256];
+    static bool table_ready = [] {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)table_ready;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static std::atomic<bool> verify_after_embed(false);
+
+void embed_verify_enable(bool on)
+{
+    verify_after_embed.store(on, std::memory_order_relaxed);
+}
+
+bool embed_verify_enabled()
+{
+    return verify_after_embed.load(std::memory_order_relaxed);
+}
+
+static void check_lsb_bits(int bits)
+{
+    if (bits < 1 || bits > 4)
     {
-        throw std::runtime_error("Failed to load image");
+        throw std::runtime_error("LSB bits per channel must be in range 1..4");
     }
+}
 
-    std::string msg = read_file_to_string(msg_file);
-    std::string message_binary;
-    for (char c : msg)
+static size_t image_bits(const std::string &image, bool per_channel)
+{
+    int width, height, channels;
+    if (!image_info(image, &width, &height, &channels))
     {
-        message_binary += std::bitset<8>(c).to_string();
+        throw std::runtime_error("Failed to load image");
     }
-    message_binary += "00000000";
+    return static_cast<size_t>(width) * height * (per_channel ? channels : 1);
+}
 
-    size_t index = 0;
-    const size_t msg_length = message_binary.length();
-    const int total_pixels = img.width * img.height * img.channels;
-    int q = std::stoi(q_str);
+size_t lsb_capacity(const std::string &image, int bits)
+{
+    check_lsb_bits(bits);
+    return lsb_capacity_pixels(image_bits(image, true), bits);
+}
 
-    for (int i = 0; i < total_pixels; ++i)
-    {
-        if (index >= msg_length)
-            break;
+size_t qim_capacity(const std::string &image)
+{
+    return qim_capacity_pixels(image_bits(image, true));
+}
 
-        int v1 = static_cast<int>(img.data[i]);
-        int v2 = q * (v1 / q) + (q / 2) * (message_binary[index] - '0');
-        img.data[i] = static_cast<unsigned char>(v2);
-        ++index;
-    }
+size_t cd_capacity(const std::string &image)
+{
+    return cd_capacity_pixels(image_bits(image, false));
+}
 
-    stbi_write_png(stego.c_str(), img.width, img.height, img.channels, img.data, img.width * img.channels);
+// One slot per channel byte (LSB, QIM) or pixel (CD), the terminating zero takes the last byte
+size_t lsb_capacity_pixels(size_t count, int bits)
+{
+    check_lsb_bits(bits);
+    const size_t bytes = count * bits / 8;
+    return bytes > 0 ? bytes - 1 : 0;
 }
 
-void qim_extract(const std::string &stego, const std::string &q_str, const std::string &output_file)
+size_t qim_capacity_pixels(size_t count)
 {
-    ImageData img;
-    img.data = stbi_load(stego.c_str(), &img.width, &img.height, &img.channels, 0);
-    if (!img.data)
+    return count / 8 > 0 ? count / 8 - 1 : 0;
+}
+
+size_t cd_capacity_pixels(size_t pixel_count)
+{
+    return pixel_count / 8 > 0 ? pixel_count / 8 - 1 : 0;
+}
+
+namespace
+{
+// Bit i of the message stream, most significant bit of every byte first
+inline int message_bit(const std::string &msg, size_t i)
+{
+    return (static_cast<unsigned char>(msg[i / 8]) >> (7 - i % 8)) & 1;
+}
+
+// Collects bits into bytes until a zero byte, which terminates QIM and CD messages
+class TerminatedReader
+{
+public:
+    bool push(int bit)
     {
-        throw std::runtime_error("Failed to load image");
+        current = static_cast<unsigned char>((current << 1) | bit);
+        if (++filled < 8)
+            return true;
+        filled = 0;
+        if (current == 0)
+            return false;
+        message += static_cast<char>(current);
+        current = 0;
+        return true;
     }
 
-    std::string message_binary = "";
-    std::string extracted_message = "";
-    const int total_pixels = img.width * img.height * img.channels;
-    int q = std::stoi(q_str);
+    std::string message;
+
+private:
+    unsigned char current = 0;
+    int filled = 0;
+};
 
-    for (int i = 0; i < total_pixels; ++i)
+// Terminated methods read back only the part of the message before its first zero byte
+void verify_terminated(const std::string &extracted, const std::string &msg, const char *method)
+{
+    if (extracted.size() != std::min(msg.size(), msg.find('\0')) || msg.compare(0, extracted.size(), extracted) != 0)
     {
-        int v1 = static_cast<int>(img.data[i]);
-        int v2 = q * (v1 / q);
-        int v3 = q * (v1 / q) + (q / 2);
+        throw std::runtime_error(std::string("Verification failed: ") + method +
+                                 " extraction does not match the message");
+    }
+}
 
-        if (abs(v1 - v2) < abs(v1 - v3))
-        {
-            message_binary += '0';
-        }
-        else
-        {
-            message_binary += '1';
-        }
+// CD modulates the LSB of B when R-G is closer than G-B, otherwise the LSB of R
+inline size_t cd_target(const unsigned char *px)
+{
+    const int r = px[0], g = px[1], b = px[2];
+    return std::abs(r - g) < std::abs(g - b) ? 2 : 0;
+}
+} // namespace
 
-        if (message_binary.length() >= 8)
-        {
-            std::string byte = message_binary.substr(0, 8);
-            message_binary = message_binary.substr(8);
+void qim_embed_pixels(unsigned char *pixels, size_t count, const std::string &msg, int q, const std::string &key)
+{
+    PhaseTimer timer(PHASE_EMBED);
+    const size_t msg_bits = (msg.size() + 1) * 8;
+    const size_t limit = std::min(count, msg_bits);
+    stats_add(PIXELS_TOUCHED, limit);
+    DistortionMeter meter(count);
+    ScatterOrder order(count, key);
+    for (size_t i = 0; i < limit; ++i)
+    {
+        const size_t pos = order.at(i);
+        const int bit = i < msg.size() * 8 ? message_bit(msg, i) : 0;
+        const int v1 = pixels[pos];
+        pixels[pos] = static_cast<unsigned char>(q * (v1 / q) + (q / 2) * bit);
+        meter.record(v1, pixels[pos]);
+    }
 
-            if (byte == "00000000")
-            {
-                break;
-            }
+    timer.stop();
+    if (embed_verify_enabled())
+        verify_terminated(qim_extract_pixels(pixels, count, q, key), msg, "QIM");
+}
 
-            extracted_message += static_cast<char>(std::stoi(byte, nullptr, 2));
-        }
+std::string qim_extract_pixels(const unsigned char *pixels, size_t count, int q, const std::string &key)
+{
+    PhaseTimer timer(PHASE_EXTRACT);
+    TerminatedReader reader;
+    ScatterOrder order(count, key);
+    size_t i = 0;
+    for (; i < count; ++i)
+    {
+        const int v1 = pixels[order.at(i)];
+        const int v2 = q * (v1 / q);
+        const int v3 = v2 + q / 2;
+        if (!reader.push(std::abs(v1 - v2) < std::abs(v1 - v3) ? 0 : 1))
+            break;
     }
-
-    std::ofstream out(output_file, std::ios::binary);
-    out.write(extracted_message.c_str(), extracted_message.size());
+    stats_add(PIXELS_TOUCHED, std::min(i + 1, count));
+    return reader.message;
 }
 
-void lsb_embed(const std::string &original, const std::string &stego, const std::string &msg_file)
+void qim_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
+               const std::string &q_str, const std::string &key)
 {
     ImageData img;
-    img.data = stbi_load(original.c_str(), &img.width, &img.height, &img.channels, 0);
+    img.data = load_image(original, &img.width, &img.height, &img.channels, 0);
     if (!img.data)
     {
         throw std::runtime_error("Failed to load image");
     }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
 
-    std::string msg = read_file_to_string(msg_file);
-    std::string message_binary;
-    for (char c : msg)
+    const std::string msg = read_file_to_string(msg_file);
+    const size_t total_pixels = static_cast<size_t>(img.width) * img.height * img.channels;
+    qim_embed_pixels(img.data, total_pixels, msg, std::stoi(q_str), key);
+
+    write_image(stego, img.width, img.height, img.channels, img.data);
+}
+
+void qim_extract(const std::string &stego, const std::string &q_str, const std::string &output_file,
+                 const std::string &key)
+{
+    ImageData img;
+    img.data = load_image(stego, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
     {
-        message_binary += std::bitset<8>(c).to_string();
+        throw std::runtime_error("Failed to load image");
     }
-    message_binary += "00000000";
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
 
-    size_t index = 0;
-    const size_t msg_length = message_binary.length();
-    const int total_pixels = img.width * img.height * img.channels;
+    const size_t total_pixels = static_cast<size_t>(img.width) * img.height * img.channels;
+    write_file(output_file, qim_extract_pixels(img.data, total_pixels, std::stoi(q_str), key));
+}
 
-    for (int i = 0; i < total_pixels; ++i)
+void lsb_embed_pixels(unsigned char *pixels, size_t count, const std::string &msg, const std::string &key, int bits)
+{
+    check_lsb_bits(bits);
+    std::vector<unsigned char> symbols;
     {
-        if (index >= msg_length)
-            break;
+        PhaseTimer timer(PHASE_MESSAGE);
+        symbols = unpack_symbols(msg + '\0', bits);
+    }
+    if (symbols.size() > count)
+    {
+        throw std::runtime_error("Message too large for the image");
+    }
 
-        int v1 = static_cast<int>(img.data[i]);
-        if (v1 % 2 == 0)
-        {
-            v1 += (message_binary[index] - '0');
-        }
-        else
+    PhaseTimer timer(PHASE_EMBED);
+    stats_add(PIXELS_TOUCHED, symbols.size());
+    DistortionMeter meter(count);
+    ScatterOrder order(count, key);
+    if (order.keyed())
+    {
+        const unsigned char keep = static_cast<unsigned char>(0xFF << bits);
+        for (size_t i = 0; i < symbols.size(); ++i)
         {
-            if (message_binary[index] == '0')
-            {
-                v1 -= 1;
-            }
+            const size_t pos = order.at(i);
+            const int before = pixels[pos];
+            pixels[pos] = static_cast<unsigned char>((before & keep) | symbols[i]);
+            meter.record(before, pixels[pos]);
         }
-
-        img.data[i] = static_cast<unsigned char>(v1);
-        ++index;
+    }
+    else
+    {
+        lsb_insert_bits(pixels, symbols.data(), symbols.size(), bits, meter.enabled() ? &meter : nullptr);
     }
 
-    stbi_write_png(stego.c_str(), img.width, img.height, img.channels, img.data, img.width * img.channels);
+    timer.stop();
+    if (embed_verify_enabled())
+        verify_terminated(lsb_extract_pixels(pixels, count, key, bits), msg, "LSB");
 }
 
-void lsb_extract(const std::string &stego, const std::string &output_file)
+std::string lsb_extract_pixels(const unsigned char *pixels, size_t count, const std::string &key, int bits)
 {
-    ImageData img;
-    img.data = stbi_load(stego.c_str(), &img.width, &img.height, &img.channels, 0);
-    if (!img.data)
+    check_lsb_bits(bits);
+    PhaseTimer timer(PHASE_EXTRACT);
+    std::string extracted_message;
+    ScatterOrder order(count, key);
+
+    // Chunk of 8*N symbols always packs into whole bytes, so no bits carry over between chunks
+    const size_t chunk = 8 * 4096;
+    std::vector<unsigned char> symbols(chunk);
+    const unsigned char mask = static_cast<unsigned char>((1u << bits) - 1);
+    for (size_t start = 0; start < count; start += chunk)
     {
-        throw std::runtime_error("Failed to load image");
-    }
-    std::string message_binary = "";
-    std::string extracted_message = "";
-    const int total_pixels = img.width * img.height * img.channels;
-
-    for (int i = 0; i < total_pixels; ++i)
-    {
-        int v1 = static_cast<int>(img.data[i]);
-        if (v1 % 2 == 0)
+        const size_t n = std::min(chunk, count - start);
+        if (order.keyed())
         {
-            message_binary += '0';
+            for (size_t i = 0; i < n; ++i)
+                symbols[i] = static_cast<unsigned char>(pixels[order.at(start + i)] & mask);
         }
         else
         {
-            message_binary += '1';
+            lsb_collect_bits(pixels + start, symbols.data(), n, bits);
         }
 
-        if (message_binary.length() >= 8)
-        {
-            std::string byte = message_binary.substr(0, 8);
-            message_binary = message_binary.substr(8);
-
-            if (byte == "00000000")
-            {
-                break;
-            }
+        stats_add(PIXELS_TOUCHED, n);
+        const std::string bytes = pack_symbols(symbols.data(), n, bits);
+        const size_t end = bytes.find('\0');
+        extracted_message.append(bytes, 0, end);
+        if (end != std::string::npos)
+            break;
+    }
+    return extracted_message;
+}
 
-            extracted_message += static_cast<char>(std::stoi(byte, nullptr, 2));
-        }
+void lsb_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
+               const std::string &key, int bits)
+{
+    check_lsb_bits(bits);
+    ImageData img;
+    img.data = load_image(original, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
     }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    const std::string msg = read_file_to_string(msg_file);
+    const size_t total_pixels = static_cast<size_t>(img.width) * img.height * img.channels;
+    lsb_embed_pixels(img.data, total_pixels, msg, key, bits);
 
-    std::ofstream out(output_file, std::ios::binary);
-    out.write(extracted_message.c_str(), extracted_message.size());
+    write_image(stego, img.width, img.height, img.channels, img.data);
 }
 
-void cd_embed(const std::string &original, const std::string &stego, const std::string &msg_file)
+void lsb_extract(const std::string &stego, const std::string &output_file, const std::string &key, int bits)
 {
+    check_lsb_bits(bits);
     ImageData img;
-    img.data = stbi_load(original.c_str(), &img.width, &img.height, &img.channels, 0);
+    img.data = load_image(stego, &img.width, &img.height, &img.channels, 0);
     if (!img.data)
     {
         throw std::runtime_error("Failed to load image");
     }
-    std::string msg = read_file_to_string(msg_file);
-    std::string message_binary;
-    for (char c : msg)
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    const size_t total_pixels = static_cast<size_t>(img.width) * img.height * img.channels;
+    write_file(output_file, lsb_extract_pixels(img.data, total_pixels, key, bits));
+}
+
+void cd_embed_pixels(unsigned char *pixels, size_t pixel_count, int channels, const std::string &msg,
+                     const std::string &key)
+{
+    PhaseTimer timer(PHASE_EMBED);
+    const size_t msg_bits = (msg.size() + 1) * 8;
+    const size_t limit = std::min(pixel_count, msg_bits);
+    stats_add(PIXELS_TOUCHED, limit * 3);
+    DistortionMeter meter(pixel_count * channels);
+    ScatterOrder order(pixel_count, key, channels);
+    for (size_t i = 0; i < limit; ++i)
     {
-        message_binary += std::bitset<8>(c).to_string();
+        unsigned char *px = pixels + order.at(i) * channels;
+        const int bit = i < msg.size() * 8 ? message_bit(msg, i) : 0;
+        unsigned char &target = px[cd_target(px)];
+        const int before = target;
+        // Odd values drop to even for 0, even values rise to odd for 1, so 255 and 0 never wrap
+        target = static_cast<unsigned char>(bit ? target | 1 : target & 0xFE);
+        meter.record(before, target);
     }
-    message_binary += "00000000";
 
-    size_t index = 0;
-    const size_t msg_length = message_binary.length();
-    const int total_pixels = img.width * img.height;
+    timer.stop();
+    if (embed_verify_enabled())
+        verify_terminated(cd_extract_pixels(pixels, pixel_count, channels, key), msg, "CD");
+}
 
-    for (int i = 0; i < total_pixels; ++i)
+std::string cd_extract_pixels(const unsigned char *pixels, size_t pixel_count, int channels, const std::string &key)
+{
+    PhaseTimer timer(PHASE_EXTRACT);
+    TerminatedReader reader;
+    ScatterOrder order(pixel_count, key, channels);
+    size_t i = 0;
+    for (; i < pixel_count; ++i)
     {
-        if (index >= msg_length)
+        const unsigned char *px = pixels + order.at(i) * channels;
+        if (!reader.push(px[cd_target(px)] & 1))
             break;
-
-        int r = img.data[i * img.channels + 0];
-        int g = img.data[i * img.channels + 1];
-        int b = img.data[i * img.channels + 2];
-        int diff_rg = r - g;
-        int diff_gb = g - b;
-
-        if (abs(diff_rg) < abs(diff_gb))
-        {
-            if (message_binary[index] == '1')
-            {
-                if (b % 2 == 0)
-                {
-                    b += 1;
-                }
-            }
-            else
-            {
-                if (b % 2 != 0)
-                {
-                    b -= 1;
-                }
-            }
-        }
-        else
-        {
-            if (message_binary[index] == '1')
-            {
-                if (r % 2 == 0)
-                {
-                    r += 1;
-                }
-            }
-            else
-            {
-                if (r % 2 != 0)
-                {
-                    r -= 1;
-                }
-            }
-        }
-
-        img.data[i * img.channels + 0] = static_cast<unsigned char>(r);
-        img.data[i * img.channels + 2] = static_cast<unsigned char>(b);
-        ++index;
     }
-
-    stbi_write_png(stego.c_str(), img.width, img.height, img.channels, img.data, img.width * img.channels);
+    stats_add(PIXELS_TOUCHED, std::min(i + 1, pixel_count) * 3);
+    return reader.message;
 }
 
-void cd_extract(const std::string &stego, const std::string &output_file)
+void cd_embed(const std::string &original, const std::string &stego, const std::string &msg_file,
+              const std::string &key)
 {
     ImageData img;
-    img.data = stbi_load(stego.c_str(), &img.width, &img.height, &img.channels, 0);
+    img.data = load_image(original, &img.width, &img.height, &img.channels, 0);
     if (!img.data)
     {
         throw std::runtime_error("Failed to load image");
     }
-    std::string message_binary = "";
-    std::string extracted_message = "";
-    const int total_pixels = img.width * img.height;
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
 
-    for (int i = 0; i < total_pixels; ++i)
-    {
-        int r = img.data[i * img.channels + 0];
-        int g = img.data[i * img.channels + 1];
-        int b = img.data[i * img.channels + 2];
-
-        int diff_rg = r - g;
-        int diff_gb = g - b;
+    const std::string msg = read_file_to_string(msg_file);
+    cd_embed_pixels(img.data, static_cast<size_t>(img.width) * img.height, img.channels, msg, key);
 
-        if (abs(diff_rg) < abs(diff_gb))
-        {
-            if (b % 2 == 0)
-            {
-                message_binary += '0';
-            }
-            else
-            {
-                message_binary += '1';
-            }
-        }
-        else
-        {
-            if (r % 2 == 0)
-            {
-                message_binary += '0';
-            }
-            else
-            {
-                message_binary += '1';
-            }
-        }
+    write_image(stego, img.width, img.height, img.channels, img.data);
+}
 
-        if (message_binary.length() >= 8)
-        {
-            std::string byte = message_binary.substr(0, 8);
-            message_binary = message_binary.substr(8);
-
-            if (byte == "00000000")
-            {
-                break;
-            }
-            extracted_message += static_cast<char>(std::stoi(byte, nullptr, 2));
-        }
+void cd_extract(const std::string &stego, const std::string &output_file, const std::string &key)
+{
+    ImageData img;
+    img.data = load_image(stego, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
     }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
 
-    std::ofstream out(output_file, std::ios::binary);
-    out.write(extracted_message.c_str(), extracted_message.size());
-}
\ No newline at end of file
+    write_file(output_file,
+               cd_extract_pixels(img.data, static_cast<size_t>(img.width) * img.height, img.channels, key));
+}
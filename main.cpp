@@ -5,53 +5,230 @@
  */
 
 /**
- * \brief Обрабатывает аргументы командной строки и вызывает соответствующие функции 
+ * \brief Обрабатывает аргументы командной строки и вызывает соответствующие функции
  * для выполнения операций стеганографии с использованием различных методов
+ *
+ * Необязательный флаг `--key <ключ>` в любом месте командной строки включает
+ * псевдослучайное рассеивание битов для методов lsb, qim, cd, cs и mbc, флаг
+ * `--bits <1..4>` задаёт количество младших битов на байт канала для lsb и gif.
+ * Метод gif принимает анимированный GIF и сохраняет результат как APNG.
+ *
+ * Режим `<метод> c <изображение>` печатает вместимость контейнера в байтах; вместе с
+ * `--adaptive` (только lsb, qim и cd) - вместимость текстурных байтов, для qim после
+ * изображения указывается шаг q.
+ * Флаг `--adaptive <порог>` для lsb, qim и cd встраивает и извлекает сообщение только
+ * в текстурных пикселях, где отклик Собеля не меньше порога; тот же порог нужен при извлечении.
+ * Режим `shard e <cs|mbc> <сообщение> <индекс> <каталог> <контейнеры...>` раскладывает
+ * сообщение по нескольким контейнерам, `shard x <индекс> <выход>` собирает его обратно.
+ *
+ * Вместо любого пути к изображению, сообщению или результату можно указать "-":
+ * данные читаются из stdin и пишутся в stdout без временных файлов (stdin - только
+ * для одного аргумента). Методы cs, mbc и eof при извлечении принимают необязательный
+ * путь результата и по умолчанию пишут байты сообщения в stdout как есть.
+ *
+ * `eof a <сообщение> <контейнер> <выход>` добавляет слот в контейнер и печатает его номер,
+ * `eof s <контейнер> <номер> [выход]` читает слот по номеру.
+ *
+ * `multi e <lsb|qim> <параметр> <контейнер> <выход> <сообщения...>` встраивает несколько
+ * сообщений в непересекающиеся области за один проход (параметр - бит на канал или шаг q),
+ * `multi x <lsb|qim> <параметр> <контейнер> <номер> [выход]` извлекает одно из них.
+ *
+ * `auto e <сообщение> <контейнер> <выход>` сам выбирает из lsb, qim, cd, cs и mbc самый
+ * быстрый метод, в который помещается сообщение, печатает его и записывает выбор в
+ * заголовок внутри пикселей; `auto x <стего> [выход]` извлекает сообщение без параметров.
+ * Флаг `--min-psnr <дБ>` отбрасывает методы, искажающие контейнер сильнее порога,
+ * `--auto-model <файл>` берёт скорости методов из JSON `stego_bench --update` вместо
+ * встроенных.
+ *
+ * `analyze <изображения или каталоги...>` печатает по строке JSON со статистикой
+ * хи-квадрат и RS-анализа на изображение; флаг `--analyze` после встраивания
+ * анализирует результат и печатает JSON в stderr.
+ *
+ * Флаг `--stats` включает замеры времени фаз (чтение, декодирование, подготовка
+ * сообщения, встраивание, извлечение, кодирование, запись) и счётчики байтов, байтов
+ * каналов и выделений памяти; после выполнения команды отчёт печатается в stderr
+ * одной строкой JSON, для пакетных команд - суммарно по всем изображениям.
+ * Флаг `--perf-counters` дополнительно снимает аппаратные счётчики (такты, инструкции,
+ * промахи кэша и предсказания переходов) вокруг каждой фазы и добавляет в отчёт IPC и
+ * доли промахов; если счётчики недоступны, отчёт содержит причину, команда выполняется.
+ *
+ * Флаг `--verify` после встраивания извлекает сообщение из изменённого буфера (для eof и
+ * chunk - из записанного хвоста файла) и завершает команду ошибкой при расхождении.
+ *
+ * Флаг `--distortion` копит искажение носителя прямо в проходе встраивания (сумма
+ * квадратов разностей, наибольшая разность, число изменённых байтов каналов) и после
+ * команды печатает в stderr JSON с MSE и PSNR; для пакетных команд - суммарно.
+ *
+ * Флаг `--cache <каталог>` хранит декодированные носители в файлах-спутниках, и
+ * следующие запуски читают пиксели через mmap без распаковки PNG; `--cache-limit <МБ>`
+ * ограничивает размер каталога (по умолчанию 1024 МБ), старые спутники удаляются.
  * \param argc Количество аргументов командной строки
  * \param argv Массив аргументов командной строки
  */
 int main(int argc, char *argv[])
 {
-    if ((strcmp(argv[1], "lsb") == 0) && (strcmp(argv[2], "e") == 0))
-        lsb_embed(argv[4], argv[5], argv[3]);
-    else if ((strcmp(argv[1], "lsb") == 0) && (strcmp(argv[2], "x") == 0))
-        lsb_extract(argv[3], argv[4]);
-    else if ((strcmp(argv[1], "qim") == 0) && (strcmp(argv[2], "e") == 0))
-        qim_embed(argv[4], argv[5], argv[3], argv[6]);
-    else if ((strcmp(argv[1], "qim") == 0) && (strcmp(argv[2], "x") == 0))
-        qim_extract(argv[3], argv[5], argv[4]);
-    else if ((strcmp(argv[1], "cd") == 0) && (strcmp(argv[2], "e") == 0))
-        cd_embed(argv[4], argv[5], argv[3]);
-    else if ((strcmp(argv[1], "cd") == 0) && (strcmp(argv[2], "x") == 0))
-        cd_extract(argv[3], argv[4]);
-    else if ((strcmp(argv[1], "cs") == 0) && (strcmp(argv[2], "e") == 0)) {
-        ChannelSwapping cs;
-        cs.encode(argv[4], read_file_to_string(argv[3]), argv[5]);
-    }
-    else if ((strcmp(argv[1], "cs") == 0) && (strcmp(argv[2], "x") == 0)) {
-        ChannelSwapping cs;
-        std::string result = cs.decode(argv[3], std::stoll(argv[4]));
-        std::cout << result << std::endl;
-    }
-    else if ((strcmp(argv[1], "mbc") == 0) && (strcmp(argv[2], "e") == 0)) {
-        MidBitChange mbc;
-        mbc.encode(argv[4], read_file_to_string(argv[3]), argv[5]);
-    }
-    else if ((strcmp(argv[1], "mbc") == 0) && (strcmp(argv[2], "x") == 0)) {
-        MidBitChange mbc;
-        std::string result = mbc.decode(argv[3], std::stoull(argv[4]));
-        std::cout << result << std::endl;
-    }
-    else if ((strcmp(argv[1], "eof") == 0) && (strcmp(argv[2], "e") == 0)) {
+    std::string key;
+    int bits = 1;
+    bool analyze = false;
+    bool stats = false;
+    bool perf_counters = false;
+    bool verify = false;
+    bool distortion = false;
+    int adaptive = -1;
+    double min_psnr = 0;
+    std::string auto_model;
+    std::string cache_dir;
+    uint64_t cache_limit_mb = 1024;
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--key") == 0 && i + 1 < argc)
+            key = argv[++i];
+        else if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc)
+            bits = std::stoi(argv[++i]);
+        else if (strcmp(argv[i], "--analyze") == 0)
+            analyze = true;
+        else if (strcmp(argv[i], "--stats") == 0)
+            stats = true;
+        else if (strcmp(argv[i], "--perf-counters") == 0)
+            stats = perf_counters = true;
+        else if (strcmp(argv[i], "--verify") == 0)
+            verify = true;
+        else if (strcmp(argv[i], "--distortion") == 0)
+            distortion = true;
+        else if (strcmp(argv[i], "--adaptive") == 0 && i + 1 < argc)
+            adaptive = std::stoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-psnr") == 0 && i + 1 < argc)
+            min_psnr = std::stod(argv[++i]);
+        else if (strcmp(argv[i], "--auto-model") == 0 && i + 1 < argc)
+            auto_model = argv[++i];
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            cache_dir = argv[++i];
+        else if (strcmp(argv[i], "--cache-limit") == 0 && i + 1 < argc)
+            cache_limit_mb = std::stoull(argv[++i]);
+        else
+            args.push_back(argv[i]);
+    }
+    if (args.size() < 3)
+    {
+        std::cerr << "Error: incorrect arguments" << std::endl;
+        return 0;
+    }
+    stats_enable(stats);
+    embed_verify_enable(verify);
+    distortion_enable(distortion);
+    carrier_cache_configure(cache_dir, cache_limit_mb << 20);
+    auto_model_load(auto_model);
+    if (perf_counters && !perf_counters_enable(true))
+        std::cerr << "Warning: hardware counters " << perf_counters_status() << std::endl;
+
+    if (args[1] == "analyze") {
+        for (const auto &analysis : analyze_images(std::vector<std::string>(args.begin() + 2, args.end())))
+            std::cout << analysis_to_json(analysis) << std::endl;
+    }
+    else if (adaptive >= 0 && (args[1] == "lsb" || args[1] == "qim" || args[1] == "cd") && (args[2] == "c"))
+        std::cout << adaptive_capacity(args[1], args[3], args[1] == "qim" ? std::stoi(args[4]) : bits, adaptive)
+                  << std::endl;
+    else if (adaptive >= 0 && (args[2] == "c"))
+        std::cerr << "Error: --adaptive capacity is supported only for lsb, qim and cd" << std::endl;
+    else if ((args[1] == "lsb") && (args[2] == "c"))
+        std::cout << lsb_capacity(args[3], bits) << std::endl;
+    else if ((args[1] == "qim") && (args[2] == "c"))
+        std::cout << qim_capacity(args[3]) << std::endl;
+    else if ((args[1] == "cd") && (args[2] == "c"))
+        std::cout << cd_capacity(args[3]) << std::endl;
+    else if ((args[1] == "cs") && (args[2] == "c"))
+        std::cout << ChannelSwapping().capacity(args[3]) << std::endl;
+    else if ((args[1] == "mbc") && (args[2] == "c"))
+        std::cout << MidBitChange().capacity(args[3]) << std::endl;
+    else if ((args[1] == "gif") && (args[2] == "c"))
+        std::cout << gif_capacity(args[3], bits) << std::endl;
+    else if (adaptive >= 0 && (args[1] == "lsb" || args[1] == "qim" || args[1] == "cd") && (args[2] == "e"))
+        adaptive_embed(args[1], args[4], args[5], args[3], args[1] == "qim" ? std::stoi(args[6]) : bits, adaptive, key);
+    else if (adaptive >= 0 && (args[1] == "lsb" || args[1] == "qim" || args[1] == "cd") && (args[2] == "x"))
+        adaptive_extract(args[1], args[3], args[4], args[1] == "qim" ? std::stoi(args[5]) : bits, adaptive, key);
+    else if ((args[1] == "lsb") && (args[2] == "e"))
+        lsb_embed(args[4], args[5], args[3], key, bits);
+    else if ((args[1] == "lsb") && (args[2] == "x"))
+        lsb_extract(args[3], args[4], key, bits);
+    else if ((args[1] == "qim") && (args[2] == "e"))
+        qim_embed(args[4], args[5], args[3], args[6], key);
+    else if ((args[1] == "qim") && (args[2] == "x"))
+        qim_extract(args[3], args[5], args[4], key);
+    else if ((args[1] == "cd") && (args[2] == "e"))
+        cd_embed(args[4], args[5], args[3], key);
+    else if ((args[1] == "cd") && (args[2] == "x"))
+        cd_extract(args[3], args[4], key);
+    else if ((args[1] == "gif") && (args[2] == "e"))
+        gif_embed(args[4], args[5], args[3], bits);
+    else if ((args[1] == "gif") && (args[2] == "x"))
+        gif_extract(args[3], args[4], bits);
+    else if ((args[1] == "cs") && (args[2] == "e")) {
+        ChannelSwapping cs(key);
+        cs.encode(args[4], read_file_to_string(args[3]), args[5]);
+    }
+    else if ((args[1] == "cs") && (args[2] == "x")) {
+        ChannelSwapping cs(key);
+        write_file(args.size() > 5 ? args[5] : "-", cs.decode(args[3], std::stoll(args[4])));
+    }
+    else if ((args[1] == "mbc") && (args[2] == "e")) {
+        MidBitChange mbc(key);
+        mbc.encode(args[4], read_file_to_string(args[3]), args[5]);
+    }
+    else if ((args[1] == "mbc") && (args[2] == "x")) {
+        MidBitChange mbc(key);
+        write_file(args.size() > 5 ? args[5] : "-", mbc.decode(args[3], std::stoull(args[4])));
+    }
+    else if ((args[1] == "eof") && (args[2] == "e")) {
         EOFHiding eof;
-        eof.encode(argv[4], read_file_to_string(argv[3]), argv[5]);
+        eof.encode(args[4], read_file_to_string(args[3]), args[5]);
     }
-    else if ((strcmp(argv[1], "eof") == 0) && (strcmp(argv[2], "x") == 0)) {
+    else if ((args[1] == "eof") && (args[2] == "x")) {
         EOFHiding eof;
-        std::string result = eof.decode(argv[3], std::stoll(argv[4]));
-        std::cout << result << std::endl;
+        write_file(args.size() > 5 ? args[5] : "-", eof.decode(args[3], std::stoll(args[4])));
     }
+    else if ((args[1] == "eof") && (args[2] == "a")) {
+        EOFHiding eof;
+        std::cout << eof.append_slot(args[4], read_file_to_string(args[3]), args[5]) << std::endl;
+    }
+    else if ((args[1] == "eof") && (args[2] == "s")) {
+        EOFHiding eof;
+        write_file(args.size() > 5 ? args[5] : "-", eof.read_slot(args[3], std::stoull(args[4])));
+    }
+    else if ((args[1] == "chunk") && (args[2] == "e")) {
+        PNGChunkHiding chunk;
+        chunk.encode(args[4], read_file_to_string(args[3]), args[5]);
+    }
+    else if ((args[1] == "chunk") && (args[2] == "x")) {
+        PNGChunkHiding chunk;
+        write_file(args.size() > 4 ? args[4] : "-", chunk.decode(args[3]));
+    }
+    else if ((args[1] == "multi") && (args[2] == "e"))
+        multi_embed(args[3], args[5], args[6], std::vector<std::string>(args.begin() + 7, args.end()),
+                    std::stoi(args[4]), key);
+    else if ((args[1] == "multi") && (args[2] == "x"))
+        write_file(args.size() > 7 ? args[7] : "-", multi_extract(args[3], args[5], std::stoull(args[6]),
+                                                                  std::stoi(args[4]), key));
+    else if ((args[1] == "auto") && (args[2] == "e")) {
+        const AutoChoice choice = auto_embed(args[4], args[5], args[3], min_psnr, key, bits);
+        if (args[5] != "-")
+            std::cout << auto_choice_name(choice) << std::endl;
+    }
+    else if ((args[1] == "auto") && (args[2] == "x"))
+        auto_extract(args[3], args.size() > 4 ? args[4] : "-", key);
+    else if ((args[1] == "shard") && (args[2] == "e"))
+        shard_embed(args[3], args[4], std::vector<std::string>(args.begin() + 7, args.end()), args[6], args[5], key);
+    else if ((args[1] == "shard") && (args[2] == "x"))
+        shard_extract(args[3], args[4], key);
     else
         std::cerr << "Error: incorrect arguments" << std::endl;
+
+    const size_t stego_arg = args[1] == "multi" ? 6 : 5;
+    if (analyze && args[2] == "e" && args.size() > stego_arg && args[stego_arg] != "-" && args[1] != "shard")
+        std::cerr << analysis_to_json(analyze_image(args[stego_arg])) << std::endl;
+    if (distortion)
+        std::cerr << distortion_to_json() << std::endl;
+    if (stats)
+        std::cerr << stats_to_json(args[1] == "analyze" ? args[1] : args[1] + " " + args[2]) << std::endl;
     return 0;
-}
\ No newline at end of file
+}
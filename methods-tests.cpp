@@ -110,4 +110,202 @@ TEST_SUITE("EOFHiding Tests") {
             if (fs::exists(encoded_img)) fs::remove(encoded_img);
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_SUITE("Scatter key Tests") {
+    TEST_CASE("Keyed ChannelSwapping and MidBitChange") {
+        if (!fs::exists(ORIGINAL_IMAGE)) {
+            FAIL("Original image not found");
+        }
+        const std::string encoded_img = "encoded_scatter.png";
+
+        SUBCASE("ChannelSwapping with key") {
+            ChannelSwapping cs("scatter-key");
+            cs.encode(ORIGINAL_IMAGE, TEST_MESSAGE, encoded_img);
+            CHECK(cs.decode(encoded_img, TEST_MESSAGE.size()) == TEST_MESSAGE);
+        }
+
+        SUBCASE("MidBitChange with key") {
+            MidBitChange mbc("scatter-key");
+            mbc.encode(ORIGINAL_IMAGE, TEST_MESSAGE, encoded_img);
+            CHECK(mbc.decode(encoded_img, TEST_MESSAGE.size()) == TEST_MESSAGE);
+        }
+
+        if (fs::exists(encoded_img)) fs::remove(encoded_img);
+    }
+}
+
+TEST_SUITE("Sharding Tests") {
+    TEST_CASE("Split payload across carriers and reassemble") {
+        const std::string carriers_dir = "shard_carriers";
+        const std::string out_dir = "shard_out";
+        const std::string index_file = "shard_out/shards.idx";
+        const std::string msg_file = "shard_msg.bin";
+        const std::string output_file = "shard_result.bin";
+
+        fs::create_directories(carriers_dir);
+        for (int n = 0; n < 3; ++n) {
+            const int w = 64 + 16 * n, h = 48;
+            std::vector<unsigned char> pixels(w * h * 3);
+            for (int i = 0; i < w * h; ++i) {
+                pixels[i * 3] = static_cast<unsigned char>((i * 7 + n) % 200);
+                pixels[i * 3 + 1] = static_cast<unsigned char>(pixels[i * 3] + 17);
+                pixels[i * 3 + 2] = static_cast<unsigned char>(i % 256);
+            }
+            stbi_write_png((carriers_dir + "/c" + std::to_string(n) + ".png").c_str(), w, h, 3, pixels.data(), w * 3);
+        }
+
+        std::string payload;
+        for (int i = 0; i < 1200; ++i) payload += static_cast<char>((i * 31) & 0xFF);
+        std::ofstream(msg_file, std::ios::binary) << payload;
+
+        SUBCASE("ChannelSwapping shards") {
+            REQUIRE_NOTHROW(shard_embed("cs", msg_file, {carriers_dir}, out_dir, index_file));
+            REQUIRE_NOTHROW(shard_extract(index_file, output_file));
+            CHECK(read_file_to_string(output_file) == payload);
+        }
+
+        SUBCASE("MidBitChange shards with key") {
+            REQUIRE_NOTHROW(shard_embed("mbc", msg_file, {carriers_dir}, out_dir, index_file, "k"));
+            REQUIRE_NOTHROW(shard_extract(index_file, output_file, "k"));
+            CHECK(read_file_to_string(output_file) == payload);
+        }
+
+        SUBCASE("Not enough capacity") {
+            CHECK_THROWS_AS(shard_embed("cs", msg_file, {carriers_dir + "/c0.png"}, out_dir, index_file),
+                            std::runtime_error);
+        }
+
+        SUBCASE("ChannelSwapping shard on a gray carrier fails at embedding") {
+            const std::string gray = carriers_dir + "/gray.png";
+            std::vector<unsigned char> pixels(64 * 48 * 3);
+            for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = static_cast<unsigned char>(i / 3 % 256);
+            stbi_write_png(gray.c_str(), 64, 48, 3, pixels.data(), 64 * 3);
+            std::ofstream(msg_file, std::ios::binary) << payload.substr(0, 300);
+
+            CHECK_THROWS_AS(shard_embed("cs", msg_file, {gray}, out_dir, index_file), std::runtime_error);
+            REQUIRE_NOTHROW(shard_embed("mbc", msg_file, {gray}, out_dir, index_file));
+            REQUIRE_NOTHROW(shard_extract(index_file, output_file));
+            CHECK(read_file_to_string(output_file) == payload.substr(0, 300));
+        }
+
+        fs::remove_all(carriers_dir);
+        fs::remove_all(out_dir);
+        fs::remove(msg_file);
+        fs::remove(output_file);
+    }
+}
+
+TEST_SUITE("EOF slot container Tests") {
+    TEST_CASE("Append and read slots") {
+        if (!fs::exists(ORIGINAL_IMAGE)) {
+            FAIL("Original image not found");
+        }
+        const std::string container = "slots_eof.png";
+        EOFHiding eof;
+
+        CHECK(eof.append_slot(ORIGINAL_IMAGE, "first", container) == 0);
+        CHECK(eof.append_slot(container, std::string("sec\0nd", 6), container) == 1);
+        CHECK(eof.append_slot(container, TEST_MESSAGE, container) == 2);
+        CHECK(eof.slot_count(container) == 3);
+        CHECK(eof.slot_count(ORIGINAL_IMAGE) == 0);
+
+        CHECK(eof.read_slot(container, 0) == "first");
+        CHECK(eof.read_slot(container, 1) == std::string("sec\0nd", 6));
+        CHECK(eof.read_slot(container, 2) == TEST_MESSAGE);
+        CHECK_THROWS_AS(eof.read_slot(container, 3), std::runtime_error);
+
+        SUBCASE("Carrier prefix is untouched") {
+            BasicImage image(container);
+            CHECK(image.get_image_params()[0] > 0);
+            image.free_space();
+        }
+
+        SUBCASE("Many slots grow the file by payload and fixed metadata") {
+            const auto before = fs::file_size(container);
+            for (int i = 3; i < 70; ++i) {
+                CHECK(eof.append_slot(container, "slot " + std::to_string(i), container) == static_cast<size_t>(i));
+            }
+            CHECK(eof.slot_count(container) == 70);
+            for (int i = 3; i < 70; ++i) {
+                CHECK(eof.read_slot(container, i) == "slot " + std::to_string(i));
+            }
+            CHECK(eof.read_slot(container, 1) == std::string("sec\0nd", 6));
+
+            // Index blocks double, so reserved entries stay below twice the slot count
+            size_t payloads = 0;
+            for (int i = 3; i < 70; ++i) {
+                payloads += ("slot " + std::to_string(i)).size();
+            }
+            CHECK(fs::file_size(container) - before < payloads + 67 * 280 + 2 * 70 * 24);
+        }
+
+        SUBCASE("Damaged entry only breaks its own slot") {
+            eof.append_slot(container, "fourth", container);
+            // Slot 3 is the first entry of block 2, placed right after its payload
+            std::fstream f(container, std::ios::binary | std::ios::in | std::ios::out);
+            f.seekp(fs::file_size(ORIGINAL_IMAGE) + (5 + 24) + (6 + 2 * 24) + TEST_MESSAGE.size() + 3 * 280 + 6);
+            f.put('X');
+            f.close();
+            CHECK(eof.read_slot(container, 0) == "first");
+            CHECK(eof.read_slot(container, 2) == TEST_MESSAGE);
+            CHECK_THROWS_AS(eof.read_slot(container, 3), std::runtime_error);
+        }
+
+        SUBCASE("Damaged slot is detected") {
+            std::fstream f(container, std::ios::binary | std::ios::in | std::ios::out);
+            f.seekp(fs::file_size(ORIGINAL_IMAGE));
+            f.put('X');
+            f.close();
+            CHECK_THROWS_AS(eof.read_slot(container, 0), std::runtime_error);
+        }
+
+        if (fs::exists(container)) fs::remove(container);
+    }
+}
+
+TEST_SUITE("PNGChunkHiding Tests") {
+    TEST_CASE("Encode and decode stEg chunk") {
+        if (!fs::exists(ORIGINAL_IMAGE)) {
+            FAIL("Original image not found");
+        }
+        const std::string encoded_img = "encoded_chunk.png";
+        const std::string binary_message("chunk\0data\xff", 11);
+
+        PNGChunkHiding chunk;
+        chunk.encode(ORIGINAL_IMAGE, binary_message, encoded_img);
+        CHECK(chunk.decode(encoded_img) == binary_message);
+
+        SUBCASE("Pixels are unchanged") {
+            BasicImage original(ORIGINAL_IMAGE);
+            BasicImage encoded(encoded_img);
+            CHECK(original.get_pixels_range() == encoded.get_pixels_range());
+            original.free_space();
+            encoded.free_space();
+        }
+
+        SUBCASE("Encode again replaces previous chunk") {
+            const std::string reencoded_img = "reencoded_chunk.png";
+            chunk.encode(encoded_img, TEST_MESSAGE, reencoded_img);
+            CHECK(chunk.decode(reencoded_img) == TEST_MESSAGE);
+            CHECK(fs::file_size(reencoded_img) == fs::file_size(ORIGINAL_IMAGE) + 12 + TEST_MESSAGE.size());
+            fs::remove(reencoded_img);
+        }
+
+        SUBCASE("Oversized chunk length is rejected") {
+            std::string png = read_file_to_string(encoded_img);
+            const size_t type_pos = png.find("stEg");
+            REQUIRE(type_pos != std::string::npos);
+            put_be32(&png[type_pos - 4], 0x7FFFFFF0u);
+            write_file(encoded_img, png);
+            CHECK_THROWS_AS(chunk.decode(encoded_img), std::runtime_error);
+        }
+
+        SUBCASE("Errors") {
+            CHECK_THROWS_AS(chunk.decode(ORIGINAL_IMAGE), std::runtime_error);
+            CHECK_THROWS_AS(chunk.encode("non_existent.png", TEST_MESSAGE, encoded_img), std::runtime_error);
+        }
+
+        if (fs::exists(encoded_img)) fs::remove(encoded_img);
+    }
+}
@@ -2,7 +2,7 @@
 
 BasicImage::BasicImage(const std::string &img_path)
 {
-    loaded_image = stbi_load(img_path.c_str(), &w, &h, &ch, 3);
+    loaded_image = load_image(img_path, &w, &h, &ch, 3);
 
     if (!loaded_image)
     {
@@ -30,7 +30,7 @@ std::vector<unsigned char> BasicImage::get_pixels_range()
 
 void BasicImage::save_result(const std::string &output_path, std::vector<unsigned char> new_pixels)
 {
-    if (!stbi_write_png(output_path.c_str(), w, h, 3, new_pixels.data(), w * 3))
+    if (!write_image(output_path, w, h, 3, new_pixels.data()))
     {
         std::cerr << "Error: CAN NOT SAVE IMAGE." << std::endl;
     }
@@ -42,44 +42,68 @@ void BasicImage::free_space()
     stbi_image_free(loaded_image);
 }
 
-void ChannelSwapping::encode(const std::string &img_path, const std::string &sens_data, const std::string &output_path)
+ChannelSwapping::ChannelSwapping(const std::string &scatter_key) : scatter_key(scatter_key)
 {
-    BasicImage image(img_path);
-    int width = image.get_image_params()[0], height = image.get_image_params()[1],
-        channels = image.get_image_params()[2];
-    std::vector<unsigned char> pixels = image.get_pixels_range();
+}
 
-    const long long int total_bits = sens_data.size() * 8;
-    if (total_bits > width * height)
+void ChannelSwapping::embed(unsigned char *rgb, size_t pixel_count, const std::string &sens_data) const
+{
+    const size_t total_bits = sens_data.size() * 8;
+    if (sens_data.size() > capacity_pixels(pixel_count))
     {
         throw std::runtime_error("Error: TOO_MANY_SENSETIVE_DATA_TO_ENCODE: Message too large for the image");
     }
 
-    long long int bit_pos = 0;
-    for (long long int i = 0; i < pixels.size() && bit_pos < total_bits; i += 3)
+    PhaseTimer timer(PHASE_EMBED);
+    stats_add(PIXELS_TOUCHED, total_bits * 2);
+    DistortionMeter meter(pixel_count * 3);
+    ScatterOrder order(pixel_count, scatter_key, 3);
+    for (size_t bit_pos = 0; bit_pos < total_bits; ++bit_pos)
     {
-        char current_char = sens_data[bit_pos / 8];
-        bool bit = (current_char >> (7 - (bit_pos % 8))) & 1; // Get bit pos than inverse and shifts to this pos comp with 00000001 
+        unsigned char *px = rgb + order.at(bit_pos) * 3;
+        bool bit = (sens_data[bit_pos / 8] >> (7 - (bit_pos % 8))) & 1; // Get bit pos than inverse and shifts to this pos comp with 00000001
 
-        if (bit)
+        // bit 1 wants R > G, bit 0 wants R < G
+        if (bit ? px[0] <= px[1] : px[0] >= px[1])
         {
-            // R < G
-            if (pixels[i] <= pixels[i + 1])
-            {
-                std::swap(pixels[i], pixels[i + 1]);
-            }
+            std::swap(px[0], px[1]);
+            // A swap moves both channels by the same amount
+            meter.record(px[1], px[0]);
+            meter.record(px[0], px[1]);
         }
-        else
-        {
-            // R > G
-            if (pixels[i] >= pixels[i + 1])
-            {
-                std::swap(pixels[i], pixels[i + 1]);
-            }
-        }
-        bit_pos++;
     }
 
+    timer.stop();
+    if (embed_verify_enabled() && extract(rgb, pixel_count, sens_data.size()) != sens_data)
+    {
+        throw std::runtime_error("Error VERIFICATION_FAILED: Channel Swapping extraction does not match the data");
+    }
+}
+
+std::string ChannelSwapping::extract(const unsigned char *rgb, size_t pixel_count, size_t sens_data_size) const
+{
+    PhaseTimer timer(PHASE_EXTRACT);
+    const size_t total_bits = std::min(sens_data_size, capacity_pixels(pixel_count)) * 8;
+    stats_add(PIXELS_TOUCHED, total_bits * 2);
+    std::string result(total_bits / 8, '\0');
+
+    ScatterOrder order(pixel_count, scatter_key, 3);
+    for (size_t bit_pos = 0; bit_pos < total_bits; ++bit_pos)
+    {
+        const unsigned char *px = rgb + order.at(bit_pos) * 3;
+        result[bit_pos / 8] = static_cast<char>((result[bit_pos / 8] << 1) | (px[0] > px[1]));
+    }
+    return result;
+}
+
+void ChannelSwapping::encode(const std::string &img_path, const std::string &sens_data, const std::string &output_path)
+{
+    BasicImage image(img_path);
+    int width = image.get_image_params()[0], height = image.get_image_params()[1];
+    std::vector<unsigned char> pixels = image.get_pixels_range();
+
+    embed(pixels.data(), static_cast<size_t>(width) * height, sens_data);
+
     image.save_result(output_path, pixels);
     last_encoded_size = sens_data.size();
 }
@@ -87,27 +111,29 @@ void ChannelSwapping::encode(const std::string &img_path, const std::string &sen
 std::string ChannelSwapping::decode(const std::string &img_path, long long int sens_data_size)
 {
     BasicImage image(img_path);
-    int width = image.get_image_params()[0], height = image.get_image_params()[1],
-        channels = image.get_image_params()[2];
+    int width = image.get_image_params()[0], height = image.get_image_params()[1];
     unsigned char *img = image.get_image_loader();
 
-    std::string bit_string;
-    const long long int total_bits = sens_data_size * 8;
-
-    for (long long int i = 0; i < width * height * 3 && bit_string.size() < total_bits; i += 3)
-    {
-        bit_string += (img[i] > img[i + 1]) ? '1' : '0';
-    }
+    std::string result =
+        extract(img, static_cast<size_t>(width) * height, static_cast<size_t>(std::max(0LL, sens_data_size)));
 
     image.free_space();
+    return result;
+}
 
-    std::string result;
-    for (long long int i = 0; i + 8 <= bit_string.size() && result.size() < sens_data_size; i += 8)
+long long int ChannelSwapping::capacity(const std::string &img_path) const
+{
+    int w, h, ch;
+    if (!image_info(img_path, &w, &h, &ch))
     {
-        result += static_cast<char>(std::bitset<8>(bit_string.substr(i, 8)).to_ulong());
+        throw std::runtime_error("LOAD_IMAGE_PIXELS:CAN_NOT_LOAD_IMAGE_FILE.");
     }
+    return static_cast<long long int>(capacity_pixels(static_cast<size_t>(w) * h));
+}
 
-    return result;
+size_t ChannelSwapping::capacity_pixels(size_t pixel_count)
+{
+    return pixel_count / 8;
 }
 
 long long int ChannelSwapping::get_last_encoded_size() const
@@ -115,84 +141,178 @@ long long int ChannelSwapping::get_last_encoded_size() const
     return last_encoded_size;
 }
 
-void MidBitChange::encode(const std::string &img_path, const std::string &sens_data, const std::string &output_path)
+MidBitChange::MidBitChange(const std::string &scatter_key) : scatter_key(scatter_key)
 {
-    BasicImage image(img_path);
-    std::vector<unsigned char> pixels = image.get_pixels_range();
-    const size_t total_bits = sens_data.size() * 8;
+}
 
-    if (total_bits > pixels.size())
+void MidBitChange::embed(unsigned char *rgb, size_t pixel_count, const std::string &sens_data) const
+{
+    const size_t total_bits = sens_data.size() * 8;
+    if (sens_data.size() > capacity_pixels(pixel_count))
     {
-        std::cerr << "Error: Message too large for the image." << std::endl;
-        return;
+        throw std::runtime_error("Error MESSAGE_TO_LARGE_FOR_IMAGE: Message too large for the image");
     }
 
-    size_t bit_pos = 0;
-    for (size_t i = 0; i < pixels.size() && bit_pos < total_bits; ++i)
+    PhaseTimer timer(PHASE_EMBED);
+    stats_add(PIXELS_TOUCHED, total_bits);
+    DistortionMeter meter(pixel_count * 3);
+    // Slots are R and G bytes of every pixel, blue channel is never touched
+    ScatterOrder order(pixel_count * 2, scatter_key, 2);
+    for (size_t bit_pos = 0; bit_pos < total_bits; ++bit_pos)
     {
-        if (i % 3 == 2)
-            continue;
+        const size_t target = order.at(bit_pos);
+        const size_t i = target / 2 * 3 + target % 2;
+        bool bit = (sens_data[bit_pos / 8] >> (7 - (bit_pos % 8))) & 1;
+        const int before = rgb[i];
+        rgb[i] = static_cast<unsigned char>((before & 0xEF) | (bit << 4));
+        meter.record(before, rgb[i]);
+    }
 
-        char current_char = sens_data[bit_pos / 8];
-        bool bit = (current_char >> (7 - (bit_pos % 8))) & 1;
-        pixels[i] = (pixels[i] & 0xEF) | (bit << 4);
-        bit_pos++;
+    timer.stop();
+    if (embed_verify_enabled() && extract(rgb, pixel_count, sens_data.size()) != sens_data)
+    {
+        throw std::runtime_error("Error VERIFICATION_FAILED: Mid Bit Changing extraction does not match the data");
     }
+}
+
+std::string MidBitChange::extract(const unsigned char *rgb, size_t pixel_count, size_t sens_data_size) const
+{
+    PhaseTimer timer(PHASE_EXTRACT);
+    const size_t total_bits = std::min(sens_data_size, capacity_pixels(pixel_count)) * 8;
+    stats_add(PIXELS_TOUCHED, total_bits);
+    std::string result(total_bits / 8, '\0');
 
-    if (!stbi_write_png(output_path.c_str(), image.get_image_params()[0], image.get_image_params()[1],
-                        image.get_image_params()[2], pixels.data(), image.get_image_params()[0] * 3))
+    ScatterOrder order(pixel_count * 2, scatter_key, 2);
+    for (size_t bit_pos = 0; bit_pos < total_bits; ++bit_pos)
     {
-        std::cerr << "Error: Failed to save image." << std::endl;
+        const size_t target = order.at(bit_pos);
+        const size_t i = target / 2 * 3 + target % 2;
+        result[bit_pos / 8] = static_cast<char>((result[bit_pos / 8] << 1) | ((rgb[i] >> 4) & 1));
     }
+    return result;
 }
 
-std::string MidBitChange::decode(const std::string &img_path, const size_t sens_data_size)
+void MidBitChange::encode(const std::string &img_path, const std::string &sens_data, const std::string &output_path)
 {
     BasicImage image(img_path);
     std::vector<unsigned char> pixels = image.get_pixels_range();
-    std::string binary_str;
+    image.free_space();
 
-    for (size_t i = 0; i < pixels.size() && binary_str.size() < sens_data_size * 8; ++i)
+    if (sens_data.size() * 8 > pixels.size() / 3 * 2)
     {
-        if (i % 3 == 2)
-            continue;
-        bool bit = (pixels[i] >> 4) & 1;
-        binary_str += (bit ? '1' : '0');
+        std::cerr << "Error: Message too large for the image." << std::endl;
+        return;
     }
+    embed(pixels.data(), pixels.size() / 3, sens_data);
 
-    std::string result;
-    for (size_t i = 0; i + 8 <= binary_str.size(); i += 8)
+    if (!write_image(output_path, image.get_image_params()[0], image.get_image_params()[1], 3, pixels.data()))
     {
-        result += static_cast<char>(std::bitset<8>(binary_str.substr(i, 8)).to_ulong());
+        std::cerr << "Error: Failed to save image." << std::endl;
     }
+}
 
+std::string MidBitChange::decode(const std::string &img_path, const size_t sens_data_size)
+{
+    BasicImage image(img_path);
+    int width = image.get_image_params()[0], height = image.get_image_params()[1];
+
+    std::string result = extract(image.get_image_loader(), static_cast<size_t>(width) * height, sens_data_size);
+
+    image.free_space();
     return result;
 }
 
-void EOFHiding::encode(const std::string &img_path, const std::string &sens_data, const std::string &output_path)
+size_t MidBitChange::capacity(const std::string &img_path) const
 {
-    std::ifstream in(img_path, std::ios::binary);
-    if (!in.is_open())
+    int w, h, ch;
+    if (!image_info(img_path, &w, &h, &ch))
     {
-        throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + img_path + "'");
+        throw std::runtime_error("LOAD_IMAGE_PIXELS:CAN_NOT_LOAD_IMAGE_FILE.");
     }
+    return capacity_pixels(static_cast<size_t>(w) * h);
+}
+
+size_t MidBitChange::capacity_pixels(size_t pixel_count)
+{
+    return pixel_count * 2 / 8;
+}
 
-    in.seekg(0, std::ios::end);
-    if (in.tellg() == 0)
+void EOFHiding::encode(const std::string &img_path, const std::string &sens_data, const std::string &output_path)
+{
+    if (img_path != "-" && output_path != "-")
     {
-        throw std::runtime_error("Error FILE_IS_EMPTY: Input file '" + img_path + "' is empty");
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(img_path, ec);
+        if (ec)
+        {
+            throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + img_path + "'");
+        }
+        if (size == 0)
+        {
+            throw std::runtime_error("Error FILE_IS_EMPTY: Input file '" + img_path + "' is empty");
+        }
+
+        // Carrier is cloned by the kernel (reflink or copy_file_range), only the payload passes through userspace
+        copy_file_contents(img_path, output_path);
+        std::ofstream out(output_path, std::ios::binary | std::ios::app);
+        if (!out.is_open())
+        {
+            throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + output_path + "'");
+        }
+        {
+            PhaseTimer timer(PHASE_WRITE);
+            out.write(sens_data.c_str(), sens_data.size());
+            stats_add(BYTES_WRITTEN, sens_data.size());
+        }
+        out.close();
+        if (embed_verify_enabled() && !sens_data.empty() &&
+            decode(output_path, static_cast<long long int>(sens_data.size())) != sens_data)
+        {
+            throw std::runtime_error("Error VERIFICATION_FAILED: Tail of '" + output_path + "' does not match the data");
+        }
+        return;
     }
 
-    in.seekg(0, std::ios::beg);
-    std::ofstream out(output_path, std::ios::binary);
+    std::ifstream file_in;
+    std::istream *in = &std::cin;
+    if (img_path != "-")
+    {
+        file_in.open(img_path, std::ios::binary);
+        if (!file_in.is_open())
+        {
+            throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + img_path + "'");
+        }
 
-    if (!out.is_open())
+        file_in.seekg(0, std::ios::end);
+        if (file_in.tellg() == 0)
+        {
+            throw std::runtime_error("Error FILE_IS_EMPTY: Input file '" + img_path + "' is empty");
+        }
+        file_in.seekg(0, std::ios::beg);
+        in = &file_in;
+    }
+
+    std::ofstream file_out;
+    std::ostream *out = &std::cout;
+    if (output_path != "-")
     {
-        throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + output_path + "'");
+        file_out.open(output_path, std::ios::binary);
+        if (!file_out.is_open())
+        {
+            throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + output_path + "'");
+        }
+        out = &file_out;
     }
 
-    out << in.rdbuf();
-    out.write(sens_data.c_str(), sens_data.size());
+    PhaseTimer timer(PHASE_WRITE);
+    // Stream copy sets failbit when nothing was read, that is the only emptiness check for pipes
+    if (!(*out << in->rdbuf()))
+    {
+        throw std::runtime_error("Error FILE_IS_EMPTY: Input file '" + img_path + "' is empty");
+    }
+    out->write(sens_data.c_str(), sens_data.size());
+    out->flush();
+    stats_add(BYTES_WRITTEN, sens_data.size());
 }
 
 std::string EOFHiding::decode(const std::string &img_path, long long int sens_data_size)
@@ -202,17 +322,237 @@ std::string EOFHiding::decode(const std::string &img_path, long long int sens_da
         throw std::runtime_error("Error SENS_DATA_SIZE_IS_INCCORRECT: Invalid data size (must be positive)");
     }
 
-    std::ifstream in(img_path, std::ios::binary | std::ios::ate);
-    if (!in.is_open())
+    if (img_path == "-")
+    {
+        const std::string content = read_file_to_string(img_path);
+        if (static_cast<long long int>(content.size()) < sens_data_size)
+        {
+            throw std::runtime_error("Error SENS_DATA_SIZE_IS_INCCORRECT: Data size exceeds input size");
+        }
+        return content.substr(content.size() - sens_data_size);
+    }
+
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file = std::make_unique<MappedFile>(img_path);
+    }
+    catch (const std::runtime_error &)
+    {
+        throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + img_path + "'");
+    }
+
+    // Only the pages holding the tail are faulted in
+    PhaseTimer timer(PHASE_READ);
+    long long int fileSize = file->size();
+    if (fileSize < sens_data_size)
+    {
+        throw std::runtime_error("Error SENS_DATA_SIZE_IS_INCCORRECT: Data size exceeds file size");
+    }
+    stats_add(BYTES_READ, static_cast<uint64_t>(sens_data_size));
+    return std::string(file->data() + fileSize - sens_data_size, sens_data_size);
+}
+
+namespace
+{
+const char SLOT_MAGIC[8] = {'S', 'T', 'G', 'S', 'L', 'O', 'T', '2'};
+const int SLOT_BLOCKS = 32;
+const size_t SLOT_ENTRY_SIZE = 24;
+const size_t SLOT_FOOTER_SIZE = 24 + SLOT_BLOCKS * 8;
+
+void put_le(std::string &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+uint64_t get_le(const char *in, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    return value;
+}
+
+// Footer: magic[8], slot count u32, footer crc u32, carrier size u64, offsets of index blocks u64[32]
+// Block b holds entries of slots 2^b - 1 .. 2^(b+1) - 2, it is reserved zeroed when its first slot is appended
+struct SlotFooter
+{
+    uint32_t count = 0;
+    uint64_t carrier_size = 0;
+    uint64_t blocks[SLOT_BLOCKS] = {};
+};
+
+std::string footer_bytes(const SlotFooter &footer)
+{
+    std::string body;
+    put_le(body, footer.carrier_size, 8);
+    for (uint64_t block : footer.blocks)
+        put_le(body, block, 8);
+
+    std::string out(SLOT_MAGIC, 8);
+    put_le(out, footer.count, 4);
+    put_le(out, crc32(body.data(), body.size(), crc32(out.data() + 8, 4)), 4);
+    return out + body;
+}
+
+SlotFooter read_slot_footer(const MappedFile &file)
+{
+    SlotFooter footer;
+    footer.carrier_size = file.size();
+    if (file.size() < SLOT_FOOTER_SIZE)
+        return footer;
+
+    const char *in = file.data() + file.size() - SLOT_FOOTER_SIZE;
+    if (!std::equal(SLOT_MAGIC, SLOT_MAGIC + 8, in))
+        return footer;
+    if (crc32(in + 16, SLOT_FOOTER_SIZE - 16, crc32(in + 8, 4)) != get_le(in + 12, 4))
+    {
+        throw std::runtime_error("Error SLOT_CHECKSUM_MISMATCH: Slot table is damaged");
+    }
+    footer.count = static_cast<uint32_t>(get_le(in + 8, 4));
+    footer.carrier_size = get_le(in + 16, 8);
+    for (int b = 0; b < SLOT_BLOCKS; ++b)
+        footer.blocks[b] = get_le(in + 24 + b * 8, 8);
+    return footer;
+}
+
+int slot_block(size_t slot)
+{
+    int block = 0;
+    while ((slot + 1) >> (block + 1))
+        ++block;
+    return block;
+}
+
+size_t slot_in_block(size_t slot)
+{
+    return slot + 1 - (static_cast<size_t>(1) << slot_block(slot));
+}
+
+// Entry: payload offset u64, length u64, payload crc u32, entry crc u32
+std::string entry_bytes(uint64_t offset, const std::string &payload)
+{
+    std::string out;
+    put_le(out, offset, 8);
+    put_le(out, payload.size(), 8);
+    put_le(out, crc32(payload.data(), payload.size()), 4);
+    put_le(out, crc32(out.data(), out.size()), 4);
+    return out;
+}
+} // namespace
+
+size_t EOFHiding::append_slot(const std::string &img_path, const std::string &sens_data, const std::string &output_path)
+{
+    if (!std::filesystem::exists(img_path))
     {
         throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + img_path + "'");
     }
+    if (std::filesystem::file_size(img_path) == 0)
+    {
+        throw std::runtime_error("Error FILE_IS_EMPTY: Input file '" + img_path + "' is empty");
+    }
+    if (!std::filesystem::exists(output_path) || !std::filesystem::equivalent(img_path, output_path))
+    {
+        copy_file_contents(img_path, output_path);
+    }
+
+    // Only the new entry and a footer are written, the previous footer stays behind as a fixed-size dead record
+    std::string tail, entry;
+    uint64_t entry_pos = 0;
+    size_t slot;
+    {
+        MappedFile file(output_path);
+        SlotFooter footer = read_slot_footer(file);
+        slot = footer.count;
+        if (slot >= (static_cast<size_t>(1) << SLOT_BLOCKS) - 1)
+        {
+            throw std::runtime_error("Error SLOT_DOES_NOT_EXIST: Container '" + output_path + "' is full");
+        }
+
+        const uint64_t payload_offset = file.size();
+        entry = entry_bytes(payload_offset, sens_data);
+        const int block = slot_block(slot);
+        tail = sens_data;
+        if (slot_in_block(slot) == 0)
+        {
+            footer.blocks[block] = payload_offset + sens_data.size();
+            tail += entry;
+            tail.append(((static_cast<size_t>(1) << block) - 1) * SLOT_ENTRY_SIZE, '\0');
+            entry.clear();
+        }
+        else
+        {
+            entry_pos = footer.blocks[block] + slot_in_block(slot) * SLOT_ENTRY_SIZE;
+        }
+        footer.count = static_cast<uint32_t>(slot + 1);
+        tail += footer_bytes(footer);
+    }
+
+    std::fstream out(output_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!out.is_open())
+    {
+        throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + output_path + "'");
+    }
+    {
+        PhaseTimer timer(PHASE_WRITE);
+        // The entry lands in its reserved place before the footer that counts it is appended
+        if (!entry.empty())
+        {
+            out.seekp(static_cast<std::streamoff>(entry_pos));
+            out.write(entry.data(), entry.size());
+        }
+        out.seekp(0, std::ios::end);
+        out.write(tail.data(), tail.size());
+        stats_add(BYTES_WRITTEN, tail.size() + entry.size());
+    }
+    out.close();
+    if (!out)
+    {
+        throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to write file '" + output_path + "'");
+    }
+    if (embed_verify_enabled() && read_slot(output_path, slot) != sens_data)
+    {
+        throw std::runtime_error("Error VERIFICATION_FAILED: Slot " + std::to_string(slot) + " of '" + output_path +
+                                 "' does not match the data");
+    }
+    return slot;
+}
 
-    long long int fileSize = in.tellg();
-    in.seekg(fileSize - sens_data_size);
+std::string EOFHiding::read_slot(const std::string &img_path, size_t slot)
+{
+    MappedFile file(img_path);
+    const SlotFooter footer = read_slot_footer(file);
+    if (slot >= footer.count)
+    {
+        throw std::runtime_error("Error SLOT_DOES_NOT_EXIST: Container '" + img_path + "' has " +
+                                 std::to_string(footer.count) + " slots");
+    }
 
-    std::vector<char> hidden_data(sens_data_size);
-    in.read(hidden_data.data(), sens_data_size);
+    const std::string damaged = "Error SLOT_CHECKSUM_MISMATCH: Slot " + std::to_string(slot) + " is damaged";
+    const uint64_t entry_pos = footer.blocks[slot_block(slot)] + slot_in_block(slot) * SLOT_ENTRY_SIZE;
+    if (entry_pos < footer.carrier_size || entry_pos + SLOT_ENTRY_SIZE > file.size())
+    {
+        throw std::runtime_error(damaged);
+    }
+    const char *entry = file.data() + entry_pos;
+    if (crc32(entry, SLOT_ENTRY_SIZE - 4) != get_le(entry + 20, 4))
+    {
+        throw std::runtime_error(damaged);
+    }
+    const uint64_t offset = get_le(entry, 8);
+    const uint64_t length = get_le(entry + 8, 8);
+    if (offset < footer.carrier_size || offset > file.size() || length > file.size() - offset ||
+        crc32(file.data() + offset, length) != get_le(entry + 16, 4))
+    {
+        throw std::runtime_error(damaged);
+    }
+    stats_add(BYTES_READ, length);
+    return std::string(file.data() + offset, length);
+}
 
-    return std::string(hidden_data.begin(), hidden_data.end());
+size_t EOFHiding::slot_count(const std::string &img_path)
+{
+    MappedFile file(img_path);
+    return read_slot_footer(file).count;
 }
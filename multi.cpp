@@ -0,0 +1,260 @@
+#include "headers.h"
+
+namespace
+{
+const char REGION_TABLE_MAGIC[4] = {'S', 'M', 'P', 'T'};
+const size_t TABLE_HEADER_SIZE = 6;
+const size_t TABLE_ENTRY_SIZE = 8;
+
+// LSB stores k bits per channel byte, QIM one bit per byte; both address the carrier in symbols
+class RegionCodec
+{
+public:
+    RegionCodec(const std::string &method, int param)
+        : qim(method == "qim"), param(param), top(qim && param >= 2 ? qim_top_base(param) : 0)
+    {
+        if (method != "lsb" && method != "qim")
+        {
+            throw std::runtime_error("Multiple payloads support only lsb and qim methods, got: " + method);
+        }
+        if (!qim && (param < 1 || param > 4))
+        {
+            throw std::runtime_error("LSB bits per channel must be in range 1..4");
+        }
+        if (qim && param < 2)
+        {
+            throw std::runtime_error("QIM step must be at least 2");
+        }
+    }
+
+    int bits() const
+    {
+        return qim ? 1 : param;
+    }
+
+    size_t symbols(size_t bytes) const
+    {
+        return (bytes * 8 + bits() - 1) / bits();
+    }
+
+    void write(unsigned char *pixels, const ScatterOrder &order, size_t start, const std::string &bytes,
+               DistortionMeter &meter) const
+    {
+        const std::vector<unsigned char> values = unpack_symbols(bytes, bits());
+        const unsigned char keep = static_cast<unsigned char>(0xFF << bits());
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            unsigned char &target = pixels[order.at(start + i)];
+            const int before = target;
+            target = static_cast<unsigned char>(qim ? cell_base(before) + (param / 2) * values[i]
+                                                    : (before & keep) | values[i]);
+            meter.record(before, target);
+        }
+        stats_add(PIXELS_TOUCHED, values.size());
+    }
+
+    std::string read(const unsigned char *pixels, const ScatterOrder &order, size_t start, size_t bytes) const
+    {
+        std::vector<unsigned char> values(symbols(bytes));
+        const unsigned char mask = static_cast<unsigned char>((1u << bits()) - 1);
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            const int v = pixels[order.at(start + i)];
+            if (qim)
+            {
+                const int base = cell_base(v);
+                values[i] = std::abs(v - base) < std::abs(v - base - param / 2) ? 0 : 1;
+            }
+            else
+            {
+                values[i] = static_cast<unsigned char>(v & mask);
+            }
+        }
+        stats_add(PIXELS_TOUCHED, values.size());
+        return pack_symbols(values.data(), values.size(), bits()).substr(0, bytes);
+    }
+
+private:
+    // A short last cell joins the one below, so writing a one never wraps past 255
+    int cell_base(int value) const
+    {
+        return std::min(param * (value / param), top);
+    }
+
+    bool qim;
+    int param;
+    int top;
+};
+
+uint32_t get_le32(const std::string &data, size_t pos)
+{
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i)
+        value = (value << 8) | static_cast<unsigned char>(data[pos + i]);
+    return value;
+}
+
+void put_le32(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+struct RegionEntry
+{
+    size_t start;
+    size_t length;
+    uint32_t crc;
+};
+
+std::vector<RegionEntry> read_region_table(const unsigned char *pixels, size_t count, const RegionCodec &codec,
+                                           const ScatterOrder &order)
+{
+    if (codec.symbols(TABLE_HEADER_SIZE) > count)
+    {
+        throw std::runtime_error("Error REGION_TABLE_IS_DAMAGED: Carrier is too small for a region table");
+    }
+    const std::string header = codec.read(pixels, order, 0, TABLE_HEADER_SIZE);
+    if (!std::equal(REGION_TABLE_MAGIC, REGION_TABLE_MAGIC + 4, header.begin()))
+    {
+        throw std::runtime_error("Error REGION_TABLE_IS_DAMAGED: No region table in the carrier");
+    }
+    const size_t entries = static_cast<unsigned char>(header[4]) | static_cast<unsigned char>(header[5]) << 8;
+    const size_t table_size = TABLE_HEADER_SIZE + entries * TABLE_ENTRY_SIZE;
+    if (codec.symbols(table_size) > count)
+    {
+        throw std::runtime_error("Error REGION_TABLE_IS_DAMAGED: Region table does not fit the carrier");
+    }
+
+    // The table is re-read as one stream, entry boundaries need not fall on symbol boundaries
+    const std::string table = codec.read(pixels, order, 0, table_size);
+    std::vector<RegionEntry> regions(entries);
+    size_t start = codec.symbols(table_size);
+    for (size_t i = 0; i < entries; ++i)
+    {
+        regions[i].start = start;
+        regions[i].length = get_le32(table, TABLE_HEADER_SIZE + i * TABLE_ENTRY_SIZE);
+        regions[i].crc = get_le32(table, TABLE_HEADER_SIZE + i * TABLE_ENTRY_SIZE + 4);
+        start += codec.symbols(regions[i].length);
+    }
+    if (start > count)
+    {
+        throw std::runtime_error("Error REGION_TABLE_IS_DAMAGED: Regions do not fit the carrier");
+    }
+    return regions;
+}
+} // namespace
+
+void multi_embed_pixels(unsigned char *pixels, size_t count, const std::vector<std::string> &payloads,
+                        const std::string &method, int param, const std::string &key)
+{
+    const RegionCodec codec(method, param);
+    if (payloads.empty() || payloads.size() > 0xFFFF)
+    {
+        throw std::runtime_error("Number of payloads must be in range 1..65535");
+    }
+
+    std::string table(REGION_TABLE_MAGIC, 4);
+    table += static_cast<char>(payloads.size() & 0xFF);
+    table += static_cast<char>(payloads.size() >> 8);
+    std::vector<size_t> starts(payloads.size());
+    size_t used = codec.symbols(TABLE_HEADER_SIZE + payloads.size() * TABLE_ENTRY_SIZE);
+    for (size_t i = 0; i < payloads.size(); ++i)
+    {
+        if (payloads[i].size() > 0xFFFFFFFFu)
+        {
+            throw std::runtime_error("Message too large for the image");
+        }
+        put_le32(table, static_cast<uint32_t>(payloads[i].size()));
+        put_le32(table, crc32(payloads[i].data(), payloads[i].size()));
+        starts[i] = used;
+        used += codec.symbols(payloads[i].size());
+    }
+    if (used > count)
+    {
+        throw std::runtime_error("Message too large for the image");
+    }
+
+    PhaseTimer timer(PHASE_EMBED);
+    const ScatterOrder order(count, key);
+    {
+        DistortionMeter meter(count);
+        codec.write(pixels, order, 0, table, meter);
+    }
+    // Regions are disjoint, so payloads are written concurrently without locks
+    parallel_for(payloads.size(), [&](size_t i) {
+        DistortionMeter meter(0);
+        codec.write(pixels, order, starts[i], payloads[i], meter);
+    });
+
+    timer.stop();
+    if (embed_verify_enabled())
+    {
+        for (size_t i = 0; i < payloads.size(); ++i)
+        {
+            if (multi_extract_pixels(pixels, count, i, method, param, key) != payloads[i])
+            {
+                throw std::runtime_error("Verification failed: payload " + std::to_string(i) +
+                                         " extraction does not match the message");
+            }
+        }
+    }
+}
+
+std::string multi_extract_pixels(const unsigned char *pixels, size_t count, size_t index, const std::string &method,
+                                 int param, const std::string &key)
+{
+    const RegionCodec codec(method, param);
+    PhaseTimer timer(PHASE_EXTRACT);
+    const ScatterOrder order(count, key);
+    const std::vector<RegionEntry> regions = read_region_table(pixels, count, codec, order);
+    if (index >= regions.size())
+    {
+        throw std::runtime_error("Error SLOT_DOES_NOT_EXIST: Carrier has " + std::to_string(regions.size()) +
+                                 " payloads");
+    }
+
+    const RegionEntry &region = regions[index];
+    const std::string payload = codec.read(pixels, order, region.start, region.length);
+    if (crc32(payload.data(), payload.size()) != region.crc)
+    {
+        throw std::runtime_error("Error SLOT_CHECKSUM_MISMATCH: Payload " + std::to_string(index) + " is damaged");
+    }
+    return payload;
+}
+
+void multi_embed(const std::string &method, const std::string &original, const std::string &stego,
+                 const std::vector<std::string> &msg_files, int param, const std::string &key)
+{
+    ImageData img;
+    img.data = load_image(original, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    std::vector<std::string> payloads(msg_files.size());
+    for (size_t i = 0; i < msg_files.size(); ++i)
+        payloads[i] = read_file_to_string(msg_files[i]);
+
+    const size_t total_pixels = static_cast<size_t>(img.width) * img.height * img.channels;
+    multi_embed_pixels(img.data, total_pixels, payloads, method, param, key);
+
+    write_image(stego, img.width, img.height, img.channels, img.data);
+}
+
+std::string multi_extract(const std::string &method, const std::string &stego, size_t index, int param,
+                          const std::string &key)
+{
+    ImageData img;
+    img.data = load_image(stego, &img.width, &img.height, &img.channels, 0);
+    if (!img.data)
+    {
+        throw std::runtime_error("Failed to load image");
+    }
+    std::unique_ptr<unsigned char, void (*)(void *)> data_guard(img.data, stbi_image_free);
+
+    const size_t total_pixels = static_cast<size_t>(img.width) * img.height * img.channels;
+    return multi_extract_pixels(img.data, total_pixels, index, method, param, key);
+}
@@ -0,0 +1,177 @@
+#include "headers.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+std::atomic<bool> requested(false);
+std::mutex status_mutex;
+std::string status = "disabled";
+bool live = false;
+
+void set_status(const std::string &value)
+{
+    std::lock_guard<std::mutex> lock(status_mutex);
+    status = value;
+    live = false;
+}
+
+// Threads open their own counters; once any thread counts, a failing or incomplete thread only downgrades to partial
+void report_thread(bool opened, bool complete, const std::string &error)
+{
+    std::lock_guard<std::mutex> lock(status_mutex);
+    if (!opened)
+    {
+        status = live ? "partial" : "unavailable: " + error;
+        return;
+    }
+    if (!live)
+        status = complete ? "enabled" : "partial";
+    else if (!complete)
+        status = "partial";
+    live = true;
+}
+
+#if defined(__linux__)
+const uint64_t EVENT_CONFIGS[PERF_EVENT_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,       PERF_COUNT_HW_INSTRUCTIONS,        PERF_COUNT_HW_CACHE_REFERENCES,
+    PERF_COUNT_HW_CACHE_MISSES,     PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int open_event(uint64_t config, int group_fd)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group_fd == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+
+// One counter group per thread, counting only that thread; opened on first use, closed at thread exit
+class ThreadCounters
+{
+public:
+    ThreadCounters()
+    {
+        leader = open_event(EVENT_CONFIGS[0], -1);
+        if (leader < 0)
+        {
+            error = std::strerror(errno);
+            report();
+            return;
+        }
+        fds[0] = leader;
+        opened = 1;
+        order[0] = 0;
+        for (int e = 1; e < PERF_EVENT_COUNT; ++e)
+        {
+            // Events missing on this CPU stay at zero instead of failing the whole group
+            fds[e] = open_event(EVENT_CONFIGS[e], leader);
+            if (fds[e] >= 0)
+                order[opened++] = e;
+        }
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        report();
+    }
+
+    ~ThreadCounters()
+    {
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+
+    void report() const
+    {
+        report_thread(leader >= 0, opened == PERF_EVENT_COUNT, error);
+    }
+
+    bool read_sample(PerfSample &sample) const
+    {
+        if (leader < 0)
+            return false;
+        uint64_t buffer[3 + PERF_EVENT_COUNT];
+        if (read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + opened) * sizeof(uint64_t)))
+            return false;
+        // Multiplexed groups are scaled by enabled/running time
+        const double scale = buffer[2] > 0 ? static_cast<double>(buffer[1]) / buffer[2] : 1.0;
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+            sample.values[e] = 0;
+        for (uint64_t i = 0; i < buffer[0] && i < static_cast<uint64_t>(opened); ++i)
+            sample.values[order[i]] = static_cast<uint64_t>(buffer[3 + i] * scale);
+        return true;
+    }
+
+private:
+    int leader = -1;
+    int fds[PERF_EVENT_COUNT] = {-1, -1, -1, -1, -1, -1};
+    int order[PERF_EVENT_COUNT] = {};
+    int opened = 0;
+    std::string error;
+};
+
+ThreadCounters &thread_counters()
+{
+    thread_local ThreadCounters counters;
+    return counters;
+}
+#endif
+} // namespace
+
+bool perf_counters_enable(bool on)
+{
+    requested.store(on, std::memory_order_relaxed);
+    if (!on)
+    {
+        set_status("disabled");
+        return false;
+    }
+#if defined(__linux__)
+    // Counters of this thread may have been opened by an earlier enable, so their outcome is reported again
+    set_status("disabled");
+    ThreadCounters &counters = thread_counters();
+    counters.report();
+    PerfSample probe;
+    if (counters.read_sample(probe))
+        return true;
+#else
+    set_status("unavailable: not supported on this platform");
+#endif
+    requested.store(false, std::memory_order_relaxed);
+    return false;
+}
+
+bool perf_counters_enabled()
+{
+    return requested.load(std::memory_order_relaxed);
+}
+
+std::string perf_counters_status()
+{
+    std::lock_guard<std::mutex> lock(status_mutex);
+    return status;
+}
+
+bool perf_counters_read(PerfSample &sample)
+{
+#if defined(__linux__)
+    return thread_counters().read_sample(sample);
+#else
+    (void)sample;
+    return false;
+#endif
+}
@@ -0,0 +1,210 @@
+#include "headers.h"
+
+namespace
+{
+const unsigned char PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+const char STEG_CHUNK_TYPE[4] = {'s', 't', 'E', 'g'};
+const uint32_t MAX_CHUNK_LENGTH = 0x7FFFFFFF;
+
+void check_signature(std::istream &in, const std::string &img_path)
+{
+    char signature[8];
+    if (!in.read(signature, 8) || !std::equal(signature, signature + 8, reinterpret_cast<const char *>(PNG_SIGNATURE)))
+    {
+        throw std::runtime_error("Error NOT_A_PNG_FILE: '" + img_path + "' has no PNG signature");
+    }
+}
+
+void skip_bytes(std::istream &in, uint64_t count, bool seekable)
+{
+    if (seekable)
+        in.seekg(static_cast<std::streamoff>(count), std::ios::cur);
+    else
+        in.ignore(static_cast<std::streamsize>(count));
+}
+
+void write_steg_chunk(std::ostream &out, const char *data, uint32_t length)
+{
+    char header[8];
+    put_be32(header, length);
+    std::copy(STEG_CHUNK_TYPE, STEG_CHUNK_TYPE + 4, header + 4);
+    char crc[4];
+    put_be32(crc, crc32(data, length, crc32(STEG_CHUNK_TYPE, 4)));
+    out.write(header, 8);
+    out.write(data, length);
+    out.write(crc, 4);
+}
+} // namespace
+
+uint32_t get_be32(const char *in)
+{
+    return (static_cast<uint32_t>(static_cast<unsigned char>(in[0])) << 24) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(in[1])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(in[2])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(in[3]));
+}
+
+void put_be32(char *out, uint32_t value)
+{
+    out[0] = static_cast<char>(value >> 24);
+    out[1] = static_cast<char>(value >> 16);
+    out[2] = static_cast<char>(value >> 8);
+    out[3] = static_cast<char>(value);
+}
+
+void PNGChunkHiding::encode(const std::string &img_path, const std::string &sens_data, const std::string &output_path)
+{
+    std::ifstream file_in;
+    std::istream *in = &std::cin;
+    if (img_path != "-")
+    {
+        file_in.open(img_path, std::ios::binary);
+        if (!file_in.is_open())
+        {
+            throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + img_path + "'");
+        }
+        in = &file_in;
+    }
+    check_signature(*in, img_path);
+
+    std::ofstream file_out;
+    std::ostream *out = &std::cout;
+    if (output_path != "-")
+    {
+        file_out.open(output_path, std::ios::binary);
+        if (!file_out.is_open())
+        {
+            throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open output file '" + output_path + "'");
+        }
+        out = &file_out;
+    }
+    out->write(reinterpret_cast<const char *>(PNG_SIGNATURE), 8);
+
+    // Chunks are copied as opaque blocks, IDAT is never inflated
+    PhaseTimer timer(PHASE_WRITE);
+    uint64_t copied = 8;
+    std::vector<char> buffer(1 << 16);
+    char header[8];
+    bool seen_iend = false;
+    while (!seen_iend && in->read(header, 8))
+    {
+        const uint32_t length = get_be32(header);
+        const bool is_steg = std::equal(header + 4, header + 8, STEG_CHUNK_TYPE);
+        seen_iend = std::equal(header + 4, header + 8, "IEND");
+
+        if (seen_iend)
+        {
+            for (size_t pos = 0; pos < sens_data.size(); pos += MAX_CHUNK_LENGTH)
+            {
+                write_steg_chunk(*out, sens_data.data() + pos,
+                                 static_cast<uint32_t>(std::min<size_t>(MAX_CHUNK_LENGTH, sens_data.size() - pos)));
+            }
+            if (sens_data.empty())
+                write_steg_chunk(*out, "", 0);
+            copied += sens_data.size() + 12 * std::max<size_t>(1, (sens_data.size() + MAX_CHUNK_LENGTH - 1) /
+                                                                      MAX_CHUNK_LENGTH);
+        }
+
+        if (!is_steg)
+        {
+            out->write(header, 8);
+            copied += 8 + static_cast<uint64_t>(length) + 4;
+        }
+        for (uint64_t left = static_cast<uint64_t>(length) + 4; left > 0;)
+        {
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(left, buffer.size()));
+            if (!in->read(buffer.data(), n))
+            {
+                throw std::runtime_error("Error CHUNK_IS_DAMAGED: '" + img_path + "' is truncated");
+            }
+            if (!is_steg)
+                out->write(buffer.data(), n);
+            left -= n;
+        }
+    }
+
+    if (!seen_iend)
+    {
+        throw std::runtime_error("Error CHUNK_IS_DAMAGED: '" + img_path + "' has no IEND chunk");
+    }
+    out->flush();
+    stats_add(BYTES_WRITTEN, copied);
+    timer.stop();
+
+    if (embed_verify_enabled() && output_path != "-")
+    {
+        file_out.close();
+        if (decode(output_path) != sens_data)
+        {
+            throw std::runtime_error("Error VERIFICATION_FAILED: Chunks of '" + output_path +
+                                     "' do not match the data");
+        }
+    }
+}
+
+std::string PNGChunkHiding::decode(const std::string &img_path)
+{
+    std::ifstream file_in;
+    std::istream *in = &std::cin;
+    if (img_path != "-")
+    {
+        file_in.open(img_path, std::ios::binary);
+        if (!file_in.is_open())
+        {
+            throw std::runtime_error("Error FILE_CAN_NOT_BE_OPEN: Failed to open input file '" + img_path + "'");
+        }
+        in = &file_in;
+    }
+    const bool seekable = img_path != "-";
+    check_signature(*in, img_path);
+    PhaseTimer timer(PHASE_READ);
+
+    // Chunk lengths are untrusted: files are checked against their size, stdin is read in bounded pieces
+    const uint64_t file_size = seekable ? std::filesystem::file_size(img_path) : 0;
+    const uint32_t STREAM_PIECE = 1 << 20;
+    std::string result;
+    bool found = false;
+    char header[8];
+    while (in->read(header, 8))
+    {
+        const uint32_t length = get_be32(header);
+        if (std::equal(header + 4, header + 8, "IEND"))
+            break;
+        if (!std::equal(header + 4, header + 8, STEG_CHUNK_TYPE))
+        {
+            skip_bytes(*in, static_cast<uint64_t>(length) + 4, seekable);
+            continue;
+        }
+
+        const std::string damaged = "Error CHUNK_IS_DAMAGED: stEg chunk in '" + img_path + "' is damaged";
+        if (length > 0x7FFFFFFFu ||
+            (seekable && static_cast<uint64_t>(length) + 4 > file_size - static_cast<uint64_t>(in->tellg())))
+        {
+            throw std::runtime_error(damaged);
+        }
+        const size_t pos = result.size();
+        for (uint32_t done = 0; done < length;)
+        {
+            const uint32_t piece = seekable ? length - done : std::min(length - done, STREAM_PIECE);
+            result.resize(pos + done + piece);
+            if (!in->read(&result[pos + done], piece))
+            {
+                throw std::runtime_error(damaged);
+            }
+            done += piece;
+        }
+        char crc[4];
+        if (!in->read(crc, 4) || get_be32(crc) != crc32(result.data() + pos, length, crc32(STEG_CHUNK_TYPE, 4)))
+        {
+            throw std::runtime_error(damaged);
+        }
+        found = true;
+    }
+
+    if (!found)
+    {
+        throw std::runtime_error("Error CHUNK_NOT_FOUND: '" + img_path + "' has no stEg chunk");
+    }
+    stats_add(BYTES_READ, result.size());
+    return result;
+}
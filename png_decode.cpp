@@ -0,0 +1,702 @@
+#include "headers.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+const unsigned char PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+const uint32_t MAX_DIMENSION = 1u << 24;
+
+// Inflate
+
+const int LITLEN_PRIMARY_BITS = 10;
+const int DIST_PRIMARY_BITS = 8;
+const int CODELEN_PRIMARY_BITS = 7;
+const uint32_t LINK = 0x80000000u;
+const size_t COPY_SLACK = 8;
+// Densest deflate code is a 258-byte match in two bits, so no input byte inflates to more than 1032
+const size_t MAX_INFLATE_RATIO = 1032;
+
+const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DIST_BASE[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const uint8_t CODELEN_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Canonical Huffman code as a two-level table: codes up to `primary` bits resolve in one lookup, longer
+// ones follow a link to a subtable indexed by the remaining bits. Entries are symbol << 8 | length,
+// links are LINK | offset << 8 | subtable bits, and zero marks a code the stream never assigned.
+class HuffmanTable
+{
+public:
+    bool build(const uint8_t *lengths, int count, int primary_bits)
+    {
+        primary = primary_bits;
+        int counts[16] = {};
+        int max_length = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            ++counts[lengths[i]];
+            max_length = std::max<int>(max_length, lengths[i]);
+        }
+        counts[0] = 0;
+        int left = 1;
+        for (int len = 1; len < 16; ++len)
+        {
+            left = (left << 1) - counts[len];
+            if (left < 0)
+                return false;
+        }
+
+        int next[16] = {};
+        for (int len = 1, code = 0; len < 16; ++len)
+        {
+            code = (code + counts[len - 1]) << 1;
+            next[len] = code;
+        }
+        entries.assign(size_t(1) << primary, 0);
+        const int sub_bits = std::max(max_length - primary, 0);
+        for (int symbol = 0; symbol < count; ++symbol)
+        {
+            const int len = lengths[symbol];
+            if (len == 0)
+                continue;
+            uint32_t code = 0;
+            for (int i = 0, c = next[len]++; i < len; ++i)
+                code |= ((c >> i) & 1u) << (len - 1 - i);
+            if (len <= primary)
+            {
+                for (uint32_t i = code; i < (1u << primary); i += 1u << len)
+                    entries[i] = static_cast<uint32_t>(symbol) << 8 | len;
+                continue;
+            }
+            uint32_t &link = entries[code & ((1u << primary) - 1)];
+            if (!(link & LINK))
+            {
+                link = LINK | static_cast<uint32_t>(entries.size()) << 8 | sub_bits;
+                entries.resize(entries.size() + (size_t(1) << sub_bits), 0);
+            }
+            const size_t offset = (entries[code & ((1u << primary) - 1)] & ~LINK) >> 8;
+            for (uint32_t i = code >> primary; i < (1u << sub_bits); i += 1u << (len - primary))
+                entries[offset + i] = static_cast<uint32_t>(symbol) << 8 | (len - primary);
+        }
+        return true;
+    }
+
+    std::vector<uint32_t> entries;
+    int primary = 0;
+};
+
+// LSB-first bit buffer refilled a whole word at a time; past the end it shifts in zeros and counts them
+class BitReader
+{
+public:
+    BitReader(const unsigned char *data, size_t size) : begin(data), in(data), end(data + size)
+    {
+    }
+
+    // At least 56 bits are buffered afterwards
+    void refill()
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if (end - in >= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, in, 8);
+            bits |= word << count;
+            in += (63 - count) >> 3;
+            count |= 56;
+            return;
+        }
+#endif
+        while (count <= 56)
+        {
+            if (in < end)
+                bits |= static_cast<uint64_t>(*in++) << count;
+            else
+                ++padding;
+            count += 8;
+        }
+    }
+
+    uint32_t peek(int n) const
+    {
+        return static_cast<uint32_t>(bits & ((uint64_t(1) << n) - 1));
+    }
+
+    void consume(int n)
+    {
+        bits >>= n;
+        count -= n;
+    }
+
+    uint32_t take(int n)
+    {
+        const uint32_t value = peek(n);
+        consume(n);
+        return value;
+    }
+
+    // Decodes one symbol, -1 for a code the table does not assign; needs 15 buffered bits
+    int decode(const uint32_t *entries, int primary)
+    {
+        uint32_t entry = entries[peek(primary)];
+        if (entry & LINK)
+        {
+            consume(primary);
+            entry = entries[((entry & ~LINK) >> 8) + peek(entry & 0xFF)];
+        }
+        const int len = entry & 0xFF;
+        if (len == 0)
+            return -1;
+        consume(len);
+        return static_cast<int>(entry >> 8);
+    }
+
+    // Byte offset of the next unread bit, rounded up; beyond size when the stream was truncated
+    size_t position() const
+    {
+        return static_cast<size_t>(in - begin) + padding - count / 8;
+    }
+
+    // Drops the bits of a partial byte and hands the remaining bytes back to the caller
+    bool align(size_t size, size_t &pos)
+    {
+        consume(count & 7);
+        pos = position();
+        if (pos > size)
+            return false;
+        in = begin + pos;
+        bits = 0;
+        count = 0;
+        padding = 0;
+        return true;
+    }
+
+    void seek(size_t pos)
+    {
+        in = begin + pos;
+    }
+
+private:
+    const unsigned char *begin;
+    const unsigned char *in;
+    const unsigned char *end;
+    uint64_t bits = 0;
+    int count = 0;
+    size_t padding = 0;
+};
+
+bool read_dynamic_tables(BitReader &reader, HuffmanTable &litlen, HuffmanTable &dist)
+{
+    reader.refill();
+    const int hlit = static_cast<int>(reader.take(5)) + 257;
+    const int hdist = static_cast<int>(reader.take(5)) + 1;
+    const int hclen = static_cast<int>(reader.take(4)) + 4;
+    if (hlit > 286 || hdist > 30)
+        return false;
+
+    uint8_t codelen_lengths[19] = {};
+    for (int i = 0; i < hclen; ++i)
+    {
+        reader.refill();
+        codelen_lengths[CODELEN_ORDER[i]] = static_cast<uint8_t>(reader.take(3));
+    }
+    HuffmanTable codelen;
+    if (!codelen.build(codelen_lengths, 19, CODELEN_PRIMARY_BITS))
+        return false;
+
+    uint8_t lengths[286 + 30] = {};
+    for (int n = 0; n < hlit + hdist;)
+    {
+        reader.refill();
+        const int symbol = reader.decode(codelen.entries.data(), codelen.primary);
+        int repeat = 0;
+        uint8_t value = 0;
+        if (symbol < 0)
+            return false;
+        if (symbol < 16)
+        {
+            lengths[n++] = static_cast<uint8_t>(symbol);
+            continue;
+        }
+        if (symbol == 16)
+        {
+            if (n == 0)
+                return false;
+            value = lengths[n - 1];
+            repeat = 3 + static_cast<int>(reader.take(2));
+        }
+        else
+        {
+            repeat = symbol == 17 ? 3 + static_cast<int>(reader.take(3)) : 11 + static_cast<int>(reader.take(7));
+        }
+        if (n + repeat > hlit + hdist)
+            return false;
+        std::fill(lengths + n, lengths + n + repeat, value);
+        n += repeat;
+    }
+    return lengths[256] != 0 && litlen.build(lengths, hlit, LITLEN_PRIMARY_BITS) &&
+           dist.build(lengths + hlit, hdist, DIST_PRIMARY_BITS);
+}
+
+bool inflate_block(BitReader &stream, const HuffmanTable &litlen, const HuffmanTable &dist, unsigned char *out,
+                   size_t out_size, size_t &pos)
+{
+    // Stores through unsigned char may alias anything, so the hot state lives in locals rather than behind references
+    BitReader reader = stream;
+    const uint32_t *lit_entries = litlen.entries.data();
+    const uint32_t *dist_entries = dist.entries.data();
+    const int lit_bits = litlen.primary, dist_bits = dist.primary;
+    size_t at = pos;
+    bool ok = false;
+    for (;;)
+    {
+        // One refill covers the longest length code, its extra bits, distance code and distance extra bits
+        reader.refill();
+        int symbol = reader.decode(lit_entries, lit_bits);
+        // Up to three literals fit into one refill
+        for (int extra = 0; symbol >= 0 && symbol < 256 && extra < 2; ++extra)
+        {
+            if (at >= out_size)
+                break;
+            out[at++] = static_cast<unsigned char>(symbol);
+            symbol = reader.decode(lit_entries, lit_bits);
+        }
+        if (symbol < 256)
+        {
+            if (symbol < 0 || at >= out_size)
+                break;
+            out[at++] = static_cast<unsigned char>(symbol);
+            continue;
+        }
+        if (symbol == 256)
+        {
+            ok = true;
+            break;
+        }
+        const int length_code = symbol - 257;
+        if (length_code >= 29)
+            break;
+        // The literals may have used 45 of the 56 bits, a match needs up to 48
+        reader.refill();
+        const size_t length = LENGTH_BASE[length_code] + reader.take(LENGTH_EXTRA[length_code]);
+        const int dist_code = reader.decode(dist_entries, dist_bits);
+        if (dist_code < 0 || dist_code >= 30)
+            break;
+        const size_t distance = DIST_BASE[dist_code] + reader.take(DIST_EXTRA[dist_code]);
+        if (distance > at || length > out_size - at)
+            break;
+
+        unsigned char *dst = out + at;
+        const unsigned char *src = dst - distance;
+        at += length;
+        if (distance >= 8)
+        {
+            // Word copies may run up to 7 bytes past the match into the slack or bytes decoded later
+            for (size_t i = 0; i < length; i += 8)
+                std::memcpy(dst + i, src + i, 8);
+        }
+        else if (distance == 1)
+        {
+            std::memset(dst, *src, length);
+        }
+        else
+        {
+            for (size_t i = 0; i < length; ++i)
+                dst[i] = src[i];
+        }
+    }
+    stream = reader;
+    pos = at;
+    return ok;
+}
+
+const HuffmanTable &fixed_litlen()
+{
+    static const HuffmanTable table = [] {
+        uint8_t lengths[288];
+        std::fill(lengths, lengths + 144, 8);
+        std::fill(lengths + 144, lengths + 256, 9);
+        std::fill(lengths + 256, lengths + 280, 7);
+        std::fill(lengths + 280, lengths + 288, 8);
+        HuffmanTable t;
+        t.build(lengths, 288, LITLEN_PRIMARY_BITS);
+        return t;
+    }();
+    return table;
+}
+
+const HuffmanTable &fixed_dist()
+{
+    static const HuffmanTable table = [] {
+        uint8_t lengths[30];
+        std::fill(lengths, lengths + 30, 5);
+        HuffmanTable t;
+        t.build(lengths, 30, DIST_PRIMARY_BITS);
+        return t;
+    }();
+    return table;
+}
+
+// Decodes a zlib stream into exactly out_size bytes; out has COPY_SLACK bytes of room past out_size
+bool inflate_zlib(const unsigned char *data, size_t size, unsigned char *out, size_t out_size)
+{
+    if (size < 2 || (data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 || (data[0] << 8 | data[1]) % 31 != 0 ||
+        (data[1] & 0x20))
+        return false;
+    data += 2;
+    size -= 2;
+
+    BitReader reader(data, size);
+    HuffmanTable litlen, dist;
+    size_t pos = 0;
+    for (bool last = false; !last;)
+    {
+        reader.refill();
+        last = reader.take(1) != 0;
+        const uint32_t type = reader.take(2);
+        if (type == 0)
+        {
+            size_t at;
+            if (!reader.align(size, at) || size - at < 4)
+                return false;
+            const size_t length = data[at] | data[at + 1] << 8;
+            if ((length ^ (data[at + 2] | data[at + 3] << 8)) != 0xFFFF || size - at - 4 < length ||
+                length > out_size - pos)
+                return false;
+            std::memcpy(out + pos, data + at + 4, length);
+            pos += length;
+            reader.seek(at + 4 + length);
+            continue;
+        }
+        if (type == 1)
+        {
+            if (!inflate_block(reader, fixed_litlen(), fixed_dist(), out, out_size, pos))
+                return false;
+        }
+        else if (type != 2 || !read_dynamic_tables(reader, litlen, dist) ||
+                 !inflate_block(reader, litlen, dist, out, out_size, pos))
+        {
+            return false;
+        }
+        if (reader.position() > size)
+            return false;
+    }
+    return pos == out_size;
+}
+
+// Unfilter
+
+inline int paeth(int a, int b, int c)
+{
+    const int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Scalar reconstruction of bytes [from, length), also the tail of the vector loops
+void unfilter_scalar(int filter, const unsigned char *raw, unsigned char *out, const unsigned char *prior,
+                     size_t from, size_t length, size_t bpp)
+{
+    for (size_t i = from; i < length; ++i)
+    {
+        const int a = i >= bpp ? out[i - bpp] : 0;
+        const int b = prior[i];
+        const int c = i >= bpp ? prior[i - bpp] : 0;
+        int predicted = 0;
+        switch (filter)
+        {
+        case 1:
+            predicted = a;
+            break;
+        case 2:
+            predicted = b;
+            break;
+        case 3:
+            predicted = (a + b) >> 1;
+            break;
+        case 4:
+            predicted = paeth(a, b, c);
+            break;
+        }
+        out[i] = static_cast<unsigned char>(raw[i] + predicted);
+    }
+}
+
+#if defined(__SSE2__)
+// Bytes are assembled in a register: a partial memcpy into a stack word stalls store forwarding on every pixel
+template <size_t Bpp> inline __m128i load_pixel(const unsigned char *p)
+{
+    uint32_t v = 0;
+    for (size_t k = 0; k < Bpp; ++k)
+        v |= static_cast<uint32_t>(p[k]) << (8 * k);
+    return _mm_cvtsi32_si128(static_cast<int>(v));
+}
+
+template <size_t Bpp> inline void store_pixel(unsigned char *p, __m128i v)
+{
+    const uint32_t value = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+    std::memcpy(p, &value, Bpp);
+}
+
+inline __m128i load16(const unsigned char *p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+// Sub is a prefix sum over pixels: four pixels per step by two shifted adds plus the carried last pixel
+size_t unfilter_sub(const unsigned char *raw, unsigned char *out, size_t length, size_t bpp)
+{
+    __m128i last = _mm_setzero_si128();
+    size_t i = 0;
+    if (bpp == 4)
+    {
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i x = load16(raw + i);
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi8(x, last);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
+            last = _mm_shuffle_epi32(x, 0xFF);
+        }
+    }
+    else
+    {
+        // Twelve bytes per step, the four bytes stored past them are rewritten by the next step
+        const __m128i low_pixel = _mm_setr_epi8(-1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        for (; i + 16 <= length; i += 12)
+        {
+            __m128i x = load16(raw + i);
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+            x = _mm_add_epi8(x, last);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
+            last = _mm_and_si128(_mm_srli_si128(x, 9), low_pixel);
+            last = _mm_or_si128(last, _mm_slli_si128(last, 3));
+            last = _mm_or_si128(last, _mm_slli_si128(last, 6));
+        }
+    }
+    return i;
+}
+
+size_t unfilter_up(const unsigned char *raw, unsigned char *out, const unsigned char *prior, size_t length)
+{
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_add_epi8(load16(raw + i), load16(prior + i)));
+    return i;
+}
+
+// Avg and Paeth depend on the pixel just reconstructed, so they run one pixel per step in a register
+template <size_t Bpp>
+size_t unfilter_avg(const unsigned char *raw, unsigned char *out, const unsigned char *prior, size_t length)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + Bpp <= length; i += Bpp)
+    {
+        const __m128i b = load_pixel<Bpp>(prior + i);
+        // pavgb rounds up, the filter rounds down
+        const __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(load_pixel<Bpp>(raw + i), avg);
+        store_pixel<Bpp>(out + i, a);
+    }
+    return i;
+}
+
+template <size_t Bpp>
+size_t unfilter_paeth(const unsigned char *raw, unsigned char *out, const unsigned char *prior, size_t length)
+{
+    const __m128i zero = _mm_setzero_si128();
+    auto abs16 = [zero](__m128i v) { return _mm_max_epi16(v, _mm_sub_epi16(zero, v)); };
+    auto select = [](__m128i mask, __m128i yes, __m128i no) {
+        return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+    };
+    __m128i a = zero, c = zero;
+    size_t i = 0;
+    for (; i + Bpp <= length; i += Bpp)
+    {
+        const __m128i b = _mm_unpacklo_epi8(load_pixel<Bpp>(prior + i), zero);
+        const __m128i pa = abs16(_mm_sub_epi16(b, c));
+        const __m128i pb = abs16(_mm_sub_epi16(a, c));
+        const __m128i pc = abs16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+        const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+        // Ties prefer a, then b, then c
+        const __m128i nearest =
+            select(_mm_cmpeq_epi16(smallest, pa), a, select(_mm_cmpeq_epi16(smallest, pb), b, c));
+        const __m128i x = _mm_add_epi8(load_pixel<Bpp>(raw + i), _mm_packus_epi16(nearest, zero));
+        store_pixel<Bpp>(out + i, x);
+        a = _mm_unpacklo_epi8(x, zero);
+        c = b;
+    }
+    return i;
+}
+#endif
+
+void unfilter_row(int filter, const unsigned char *raw, unsigned char *out, const unsigned char *prior,
+                  size_t length, size_t bpp)
+{
+    size_t done = 0;
+    if (filter == 0)
+    {
+        std::memcpy(out, raw, length);
+        return;
+    }
+#if defined(__SSE2__)
+    switch (filter)
+    {
+    case 1:
+        done = unfilter_sub(raw, out, length, bpp);
+        break;
+    case 2:
+        done = unfilter_up(raw, out, prior, length);
+        break;
+    case 3:
+        done = bpp == 4 ? unfilter_avg<4>(raw, out, prior, length) : unfilter_avg<3>(raw, out, prior, length);
+        break;
+    case 4:
+        done = bpp == 4 ? unfilter_paeth<4>(raw, out, prior, length) : unfilter_paeth<3>(raw, out, prior, length);
+        break;
+    }
+#endif
+    unfilter_scalar(filter, raw, out, prior, done, length, bpp);
+}
+
+struct PngHeader
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int channels = 0;
+};
+
+// Collects IHDR and the IDAT payload; false for anything but 8-bit non-interlaced RGB or RGBA without tRNS
+bool read_chunks(const unsigned char *data, size_t size, PngHeader &header, std::vector<unsigned char> &joined,
+                 const unsigned char *&idat, size_t &idat_size)
+{
+    if (size < 8 || !std::equal(PNG_SIGNATURE, PNG_SIGNATURE + 8, data))
+        return false;
+    idat = nullptr;
+    idat_size = 0;
+    size_t idat_chunks = 0;
+    for (size_t pos = 8; pos + 12 <= size;)
+    {
+        const uint32_t length = get_be32(reinterpret_cast<const char *>(data + pos));
+        const unsigned char *type = data + pos + 4;
+        const unsigned char *body = data + pos + 8;
+        if (length > size - pos - 12)
+            return false;
+        pos += 12 + static_cast<size_t>(length);
+
+        if (std::memcmp(type, "IHDR", 4) == 0)
+        {
+            if (length != 13)
+                return false;
+            header.width = get_be32(reinterpret_cast<const char *>(body));
+            header.height = get_be32(reinterpret_cast<const char *>(body + 4));
+            const int depth = body[8], color = body[9];
+            if (depth != 8 || (color != 2 && color != 6) || body[10] != 0 || body[11] != 0 || body[12] != 0)
+                return false;
+            header.channels = color == 2 ? 3 : 4;
+        }
+        else if (std::memcmp(type, "tRNS", 4) == 0)
+        {
+            return false;
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0)
+        {
+            // Single-IDAT files, as written by stb and this tool, are inflated straight from the input. Split
+            // payloads are joined into one buffer sized once: the rest of the file bounds the remaining chunks
+            if (++idat_chunks == 2)
+            {
+                joined.reserve(idat_size + (data + size - body));
+                joined.assign(idat, idat + idat_size);
+            }
+            if (idat_chunks >= 2)
+                joined.insert(joined.end(), body, body + length);
+            else
+                idat = body;
+            idat_size += length;
+        }
+        else if (std::memcmp(type, "IEND", 4) == 0)
+        {
+            break;
+        }
+    }
+    if (idat_chunks >= 2)
+        idat = joined.data();
+    return header.channels != 0 && idat_chunks > 0 && header.width > 0 && header.height > 0 &&
+           header.width <= MAX_DIMENSION && header.height <= MAX_DIMENSION;
+}
+
+// stb semantics: the buffer has desired_channels (or the file's own), *channels reports the file's
+unsigned char *convert_channels(unsigned char *pixels, size_t pixel_count, int from, int to)
+{
+    unsigned char *converted = static_cast<unsigned char *>(std::malloc(pixel_count * to));
+    if (converted)
+    {
+        for (size_t i = 0; i < pixel_count; ++i)
+        {
+            std::memcpy(converted + i * to, pixels + i * from, 3);
+            if (to == 4)
+                converted[i * 4 + 3] = 255;
+        }
+    }
+    std::free(pixels);
+    return converted;
+}
+} // namespace
+
+unsigned char *png_decode(const unsigned char *data, size_t size, int *width, int *height, int *channels,
+                          int desired_channels)
+{
+    PngHeader header;
+    std::vector<unsigned char> joined;
+    const unsigned char *idat;
+    size_t idat_size;
+    if ((desired_channels != 0 && desired_channels != 3 && desired_channels != 4) ||
+        !read_chunks(data, size, header, joined, idat, idat_size))
+        return nullptr;
+
+    const size_t bpp = static_cast<size_t>(header.channels);
+    const size_t stride = header.width * bpp;
+    const size_t pixel_count = static_cast<size_t>(header.width) * header.height;
+    if (pixel_count > (size_t(1) << 31) / bpp)
+        return nullptr;
+    // Dimensions the IDAT payload cannot inflate to are rejected before the scanline buffer is allocated
+    const size_t raw_size = header.height * (stride + 1);
+    if (raw_size > idat_size * MAX_INFLATE_RATIO)
+        return nullptr;
+    // Inflate writes every byte or fails, so the buffer is left uninitialized
+    std::unique_ptr<unsigned char[]> raw(new unsigned char[raw_size + COPY_SLACK]);
+    if (!inflate_zlib(idat, idat_size, raw.get(), raw_size))
+        return nullptr;
+
+    unsigned char *pixels = static_cast<unsigned char *>(std::malloc(pixel_count * bpp));
+    if (!pixels)
+        return nullptr;
+    const std::vector<unsigned char> zero_row(stride, 0);
+    for (size_t y = 0; y < header.height; ++y)
+    {
+        const unsigned char *line = raw.get() + y * (stride + 1);
+        if (line[0] > 4)
+        {
+            std::free(pixels);
+            return nullptr;
+        }
+        unsigned char *out = pixels + y * stride;
+        unfilter_row(line[0], line + 1, out, y ? out - stride : zero_row.data(), stride, bpp);
+    }
+
+    *width = static_cast<int>(header.width);
+    *height = static_cast<int>(header.height);
+    *channels = header.channels;
+    if (desired_channels != 0 && desired_channels != header.channels)
+        return convert_channels(pixels, pixel_count, header.channels, desired_channels);
+    return pixels;
+}
@@ -0,0 +1,85 @@
+#include "headers.h"
+
+namespace
+{
+uint64_t mix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t hash_key(const std::string &key)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (unsigned char c : key)
+    {
+        h ^= c;
+        h *= 0x100000001B3ULL;
+    }
+    return mix64(h);
+}
+
+// Сбалансированная сеть Фейстеля на 2*half бит, раундовая функция - счётчиковый ГПСЧ mix64(seed, раунд, половина).
+uint64_t feistel(uint64_t x, unsigned half, uint64_t seed)
+{
+    const uint64_t mask = (1ULL << half) - 1;
+    uint64_t l = x >> half, r = x & mask;
+    for (uint64_t round = 0; round < 4; ++round)
+    {
+        uint64_t f = mix64(seed ^ (round << 56) ^ r) & mask;
+        uint64_t t = r;
+        r = l ^ f;
+        l = t;
+    }
+    return (l << half) | r;
+}
+
+// Биекция на [0, domain): сеть Фейстеля на ближайшей чётной степени двойки с обходом цикла.
+uint64_t permute(uint64_t x, uint64_t domain, uint64_t seed)
+{
+    if (domain <= 1)
+        return x;
+    unsigned bits = 0;
+    while ((1ULL << bits) < domain)
+        ++bits;
+    unsigned half = (bits + 1) / 2;
+    do
+    {
+        x = feistel(x, half, seed);
+    } while (x >= domain);
+    return x;
+}
+} // namespace
+
+ScatterOrder::ScatterOrder(size_t count, const std::string &key, size_t element_size)
+    : count(count), block(std::max<size_t>(1, SCATTER_BLOCK_BYTES / std::max<size_t>(1, element_size))),
+      full_blocks(count / block), seed(key.empty() ? 0 : hash_key(key)), enabled(!key.empty())
+{
+}
+
+size_t ScatterOrder::at(size_t i) const
+{
+    if (!enabled)
+        return i;
+
+    size_t b = i / block, offset = i % block;
+    if (b < full_blocks)
+    {
+        size_t target = permute(b, full_blocks, seed);
+        return target * block + permute(offset, block, mix64(seed ^ target));
+    }
+    // Хвост короче блока остаётся на месте, перемешивается только внутри себя
+    return b * block + permute(offset, count - b * block, mix64(seed ^ b));
+}
+
+size_t ScatterOrder::size() const
+{
+    return count;
+}
+
+bool ScatterOrder::keyed() const
+{
+    return enabled;
+}
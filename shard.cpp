@@ -0,0 +1,173 @@
+#include "headers.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+const char *SHARD_INDEX_MAGIC = "stego-shards";
+
+struct Shard
+{
+    size_t offset;
+    size_t length;
+    uint32_t crc;
+    std::string carrier;
+    std::string stego;
+};
+
+size_t carrier_capacity(const std::string &method, const std::string &carrier)
+{
+    if (method == "cs")
+        return static_cast<size_t>(ChannelSwapping().capacity(carrier));
+    return MidBitChange().capacity(carrier);
+}
+} // namespace
+
+void shard_embed(const std::string &method, const std::string &msg_file, const std::vector<std::string> &carriers,
+                 const std::string &out_dir, const std::string &index_file, const std::string &key)
+{
+    if (method != "cs" && method != "mbc")
+    {
+        throw std::runtime_error("Sharding supports only cs and mbc methods, got: " + method);
+    }
+
+    const std::string payload = read_file_to_string(msg_file);
+    const std::vector<std::string> inputs = expand_image_paths(carriers);
+
+    std::vector<size_t> capacities(inputs.size());
+    parallel_for(inputs.size(), [&](size_t i) { capacities[i] = carrier_capacity(method, inputs[i]); });
+
+    std::vector<Shard> shards;
+    size_t offset = 0;
+    for (size_t i = 0; i < inputs.size() && offset < payload.size(); ++i)
+    {
+        if (capacities[i] == 0)
+            continue;
+        Shard shard;
+        shard.offset = offset;
+        shard.length = std::min(capacities[i], payload.size() - offset);
+        shard.crc = crc32(payload.data() + offset, shard.length);
+        shard.carrier = inputs[i];
+        shard.stego = (fs::path(out_dir) / (std::to_string(shards.size()) + "_" + fs::path(inputs[i]).stem().string() +
+                                            ".png")).string();
+        shards.push_back(shard);
+        offset += shard.length;
+    }
+    if (offset < payload.size())
+    {
+        throw std::runtime_error("Carriers capacity is too small: " + std::to_string(offset) + " of " +
+                                 std::to_string(payload.size()) + " bytes fit");
+    }
+
+    fs::create_directories(out_dir);
+    parallel_for(shards.size(), [&](size_t i) {
+        const Shard &shard = shards[i];
+        const std::string part = payload.substr(shard.offset, shard.length);
+        if (method == "cs")
+            ChannelSwapping(key).encode(shard.carrier, part, shard.stego);
+        else
+            MidBitChange(key).encode(shard.carrier, part, shard.stego);
+
+        // CS cannot order pixels with R == G, so a flat or gray carrier would only fail at reassembly
+        const std::string stored = method == "cs" ? ChannelSwapping(key).decode(shard.stego, shard.length)
+                                                  : MidBitChange(key).decode(shard.stego, shard.length);
+        if (stored != part)
+        {
+            throw std::runtime_error("Shard does not read back from its carrier: " + shard.carrier + " (" + method +
+                                     ", " + std::to_string(shard.length) + " bytes)");
+        }
+    });
+
+    const fs::path index_dir = fs::absolute(index_file).parent_path();
+    std::ofstream index(index_file, std::ios::binary);
+    if (!index.is_open())
+    {
+        throw std::runtime_error("Failed to open file: " + index_file);
+    }
+    index << SHARD_INDEX_MAGIC << " 1 " << method << " " << payload.size() << " " << shards.size() << "\n";
+    for (const auto &shard : shards)
+    {
+        char crc_hex[9];
+        snprintf(crc_hex, sizeof(crc_hex), "%08x", shard.crc);
+        index << shard.offset << " " << shard.length << " " << crc_hex << " "
+              << fs::proximate(fs::absolute(shard.stego), index_dir).string() << "\n";
+    }
+}
+
+void shard_extract(const std::string &index_file, const std::string &output_file, const std::string &key)
+{
+    std::ifstream index(index_file, std::ios::binary);
+    if (!index.is_open())
+    {
+        throw std::runtime_error("Failed to open file: " + index_file);
+    }
+
+    std::string magic, method;
+    int version = 0;
+    size_t total = 0, count = 0;
+    index >> magic >> version >> method >> total >> count;
+    if (!index || magic != SHARD_INDEX_MAGIC || version != 1 || (method != "cs" && method != "mbc"))
+    {
+        throw std::runtime_error("Invalid shard index: " + index_file);
+    }
+
+    // Count comes from the file, so it is checked against the lines present before anything is allocated
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(index >> std::ws, line);)
+        lines.push_back(line);
+    if (count > lines.size())
+    {
+        throw std::runtime_error("Invalid shard index: " + std::to_string(count) + " shards declared, " +
+                                 std::to_string(lines.size()) + " listed");
+    }
+
+    const fs::path index_dir = fs::absolute(index_file).parent_path();
+    std::vector<Shard> shards(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        Shard &shard = shards[i];
+        std::istringstream entry(lines[i]);
+        std::string crc_hex, name;
+        entry >> shard.offset >> shard.length >> crc_hex;
+        std::getline(entry >> std::ws, name);
+        if (!entry || shard.offset + shard.length > total)
+        {
+            throw std::runtime_error("Invalid shard index: " + index_file);
+        }
+        shard.crc = static_cast<uint32_t>(std::stoul(crc_hex, nullptr, 16));
+        shard.stego = (index_dir / name).string();
+    }
+
+    // Shards must tile the payload exactly, a missing or repeated range would be written as zeros or twice
+    std::sort(shards.begin(), shards.end(), [](const Shard &a, const Shard &b) { return a.offset < b.offset; });
+    size_t covered = 0;
+    for (const auto &shard : shards)
+    {
+        if (shard.offset != covered)
+        {
+            throw std::runtime_error("Invalid shard index: " + std::string(shard.offset > covered ? "gap" : "overlap") +
+                                     " at byte " + std::to_string(std::min(shard.offset, covered)));
+        }
+        covered += shard.length;
+    }
+    if (covered != total)
+    {
+        throw std::runtime_error("Invalid shard index: shards cover " + std::to_string(covered) + " of " +
+                                 std::to_string(total) + " bytes");
+    }
+
+    std::string payload(total, '\0');
+    parallel_for(shards.size(), [&](size_t i) {
+        const Shard &shard = shards[i];
+        std::string part = method == "cs" ? ChannelSwapping(key).decode(shard.stego, shard.length)
+                                          : MidBitChange(key).decode(shard.stego, shard.length);
+        if (part.size() != shard.length || crc32(part.data(), part.size()) != shard.crc)
+        {
+            throw std::runtime_error("Shard checksum mismatch: " + shard.stego);
+        }
+        std::copy(part.begin(), part.end(), payload.begin() + shard.offset);
+    });
+
+    std::ofstream out(output_file, std::ios::binary);
+    out.write(payload.data(), payload.size());
+}
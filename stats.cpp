@@ -0,0 +1,209 @@
+#include "headers.h"
+#include <iomanip>
+#include <limits>
+
+namespace
+{
+const char *PHASE_NAMES[PHASE_COUNT] = {"read", "decode", "message", "embed", "extract", "encode", "write", "analyze"};
+const char *COUNTER_NAMES[COUNTER_COUNT] = {"bytes_read",      "bytes_written", "pixels_touched", "allocations",
+                                            "allocated_bytes", "cache_hits",    "cache_misses"};
+
+std::atomic<bool> enabled(false);
+std::atomic<uint64_t> phase_calls[PHASE_COUNT];
+std::atomic<uint64_t> phase_ns[PHASE_COUNT];
+std::atomic<uint64_t> counters[COUNTER_COUNT];
+std::atomic<uint64_t> phase_perf[PHASE_COUNT][PERF_EVENT_COUNT];
+std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+std::atomic<bool> distortion_on(false);
+std::atomic<uint64_t> distortion_sse(0);
+std::atomic<uint64_t> distortion_changed(0);
+std::atomic<uint64_t> distortion_samples(0);
+std::atomic<unsigned> distortion_max(0);
+} // namespace
+
+void stats_enable(bool on)
+{
+    if (on)
+        started = std::chrono::steady_clock::now();
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+bool stats_enabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void stats_reset()
+{
+    for (int i = 0; i < PHASE_COUNT; ++i)
+    {
+        phase_calls[i] = 0;
+        phase_ns[i] = 0;
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+            phase_perf[i][e] = 0;
+    }
+    for (int i = 0; i < COUNTER_COUNT; ++i)
+        counters[i] = 0;
+    started = std::chrono::steady_clock::now();
+}
+
+void stats_add(StatCounter counter, uint64_t value)
+{
+    if (enabled.load(std::memory_order_relaxed))
+        counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t stats_counter(StatCounter counter)
+{
+    return counters[counter].load();
+}
+
+uint64_t stats_phase_calls(StatPhase phase)
+{
+    return phase_calls[phase].load();
+}
+
+uint64_t stats_phase_ns(StatPhase phase)
+{
+    return phase_ns[phase].load();
+}
+
+std::string stats_to_json(const std::string &command)
+{
+    const auto wall = std::chrono::steady_clock::now() - started;
+    std::ostringstream out;
+    out.precision(3);
+    out << std::fixed << "{\"command\":\"" << command << "\",\"wall_ms\":"
+        << std::chrono::duration<double, std::milli>(wall).count() << ",\"phases\":{";
+    bool first = true;
+    for (int i = 0; i < PHASE_COUNT; ++i)
+    {
+        if (phase_calls[i] == 0)
+            continue;
+        out << (first ? "" : ",") << "\"" << PHASE_NAMES[i] << "\":{\"calls\":" << phase_calls[i]
+            << ",\"total_ms\":" << phase_ns[i] / 1e6;
+        if (perf_counters_enabled())
+        {
+            uint64_t v[PERF_EVENT_COUNT];
+            for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+                v[e] = phase_perf[i][e];
+            auto ratio = [](uint64_t a, uint64_t b) { return b ? static_cast<double>(a) / b : 0.0; };
+            out << ",\"cycles\":" << v[PERF_CYCLES] << ",\"instructions\":" << v[PERF_INSTRUCTIONS]
+                << ",\"cache_misses\":" << v[PERF_CACHE_MISSES] << ",\"branch_misses\":" << v[PERF_BRANCH_MISSES]
+                << ",\"ipc\":" << ratio(v[PERF_INSTRUCTIONS], v[PERF_CYCLES])
+                << ",\"cache_miss_rate\":" << ratio(v[PERF_CACHE_MISSES], v[PERF_CACHE_REFERENCES])
+                << ",\"branch_miss_rate\":" << ratio(v[PERF_BRANCH_MISSES], v[PERF_BRANCHES]);
+        }
+        out << "}";
+        first = false;
+    }
+    out << "},\"counters\":{";
+    for (int i = 0; i < COUNTER_COUNT; ++i)
+        out << (i ? "," : "") << "\"" << COUNTER_NAMES[i] << "\":" << counters[i];
+    out << "},\"perf_counters\":\"" << perf_counters_status() << "\"}";
+    return out.str();
+}
+
+PhaseTimer::PhaseTimer(StatPhase phase) : phase(phase), active(stats_enabled())
+{
+    if (!active)
+        return;
+    counting = perf_counters_enabled() && perf_counters_read(perf_start);
+    start = std::chrono::steady_clock::now();
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    stop();
+}
+
+void PhaseTimer::stop()
+{
+    if (!active)
+        return;
+    active = false;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    PerfSample perf_end;
+    if (counting && perf_counters_read(perf_end))
+    {
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e)
+            phase_perf[phase][e].fetch_add(perf_end.values[e] - perf_start.values[e], std::memory_order_relaxed);
+    }
+    phase_calls[phase].fetch_add(1, std::memory_order_relaxed);
+    phase_ns[phase].fetch_add(
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+        std::memory_order_relaxed);
+}
+
+void distortion_enable(bool on)
+{
+    distortion_on.store(on, std::memory_order_relaxed);
+}
+
+bool distortion_enabled()
+{
+    return distortion_on.load(std::memory_order_relaxed);
+}
+
+void distortion_reset()
+{
+    distortion_sse = 0;
+    distortion_changed = 0;
+    distortion_samples = 0;
+    distortion_max = 0;
+}
+
+DistortionTotals distortion_totals()
+{
+    DistortionTotals totals;
+    totals.sse = distortion_sse.load();
+    totals.changed = distortion_changed.load();
+    totals.samples = distortion_samples.load();
+    totals.max_delta = distortion_max.load();
+    return totals;
+}
+
+double distortion_psnr(const DistortionTotals &totals)
+{
+    if (totals.sse == 0 || totals.samples == 0)
+        return std::numeric_limits<double>::infinity();
+    const double mse = static_cast<double>(totals.sse) / totals.samples;
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+std::string distortion_to_json()
+{
+    const DistortionTotals totals = distortion_totals();
+    const double psnr = distortion_psnr(totals);
+    std::ostringstream out;
+    out.precision(6);
+    out << std::fixed << "{\"sse\":" << totals.sse << ",\"mse\":"
+        << (totals.samples ? static_cast<double>(totals.sse) / totals.samples : 0.0)
+        << ",\"max_delta\":" << totals.max_delta << ",\"changed\":" << totals.changed
+        << ",\"samples\":" << totals.samples << ",\"psnr_db\":";
+    // JSON has no infinity, an untouched carrier reports null
+    if (std::isinf(psnr))
+        out << "null";
+    else
+        out << std::setprecision(3) << psnr;
+    out << "}";
+    return out.str();
+}
+
+DistortionMeter::DistortionMeter(size_t samples) : samples(samples), active(distortion_enabled())
+{
+}
+
+DistortionMeter::~DistortionMeter()
+{
+    if (!active)
+        return;
+    distortion_sse.fetch_add(sse, std::memory_order_relaxed);
+    distortion_changed.fetch_add(changed, std::memory_order_relaxed);
+    distortion_samples.fetch_add(samples, std::memory_order_relaxed);
+    unsigned seen = distortion_max.load(std::memory_order_relaxed);
+    while (seen < max_delta && !distortion_max.compare_exchange_weak(seen, max_delta, std::memory_order_relaxed))
+    {
+    }
+}
@@ -14,6 +14,80 @@ void create_test_image(const std::string &path, int width, int height, int chann
     stbi_write_png(path.c_str(), width, height, channels, pixels.data(), width * channels);
 }
 
+// Runs the built stego_program with the given arguments and returns its exit status
+int run_program(const std::string &arguments)
+{
+    return std::system(("\"" STEGO_PROGRAM "\" " + arguments).c_str());
+}
+
+void create_test_gif(const std::string &path, int width, int height, int frames)
+{
+    std::string gif = "GIF89a";
+    auto put16 = [&gif](int v) {
+        gif += static_cast<char>(v & 0xFF);
+        gif += static_cast<char>(v >> 8);
+    };
+    put16(width);
+    put16(height);
+    gif += '\xF7';
+    gif += '\0';
+    gif += '\0';
+    for (int i = 0; i < 256; ++i)
+    {
+        gif += static_cast<char>(i);
+        gif += static_cast<char>(255 - i);
+        gif += static_cast<char>(i * 7);
+    }
+
+    for (int f = 0; f < frames; ++f)
+    {
+        gif += "\x21\xF9\x04\x04";
+        put16(10);
+        gif += '\0';
+        gif += '\0';
+        gif += '\x2C';
+        put16(0);
+        put16(0);
+        put16(width);
+        put16(height);
+        gif += '\0';
+        gif += '\x08';
+
+        // 9-bit codes only: a clear code every 128 literals keeps the LZW table from growing
+        std::string data;
+        uint32_t acc = 0;
+        int acc_bits = 0;
+        auto emit = [&](int code) {
+            acc |= static_cast<uint32_t>(code) << acc_bits;
+            acc_bits += 9;
+            while (acc_bits >= 8)
+            {
+                data += static_cast<char>(acc & 0xFF);
+                acc >>= 8;
+                acc_bits -= 8;
+            }
+        };
+        for (int i = 0; i < width * height; ++i)
+        {
+            if (i % 128 == 0)
+                emit(256);
+            emit((i * 3 + f * 40) % 256);
+        }
+        emit(257);
+        if (acc_bits > 0)
+            data += static_cast<char>(acc & 0xFF);
+        for (size_t pos = 0; pos < data.size(); pos += 255)
+        {
+            const size_t n = std::min<size_t>(255, data.size() - pos);
+            gif += static_cast<char>(n);
+            gif += data.substr(pos, n);
+        }
+        gif += '\0';
+    }
+    gif += '\x3B';
+    create_test_file(path, gif);
+}
+
 TEST_CASE("Testing read_file_to_string")
 {
     SUBCASE("Reading existing file")
@@ -139,4 +213,1198 @@ TEST_CASE("Testing CD steganography")
     std::filesystem::remove(stego_img);
     std::filesystem::remove(msg_file);
     std::filesystem::remove(output_file);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Testing keyed scatter order")
+{
+    SUBCASE("Permutation is a bijection")
+    {
+        const size_t count = 3 * SCATTER_BLOCK_BYTES + 123;
+        ScatterOrder order(count, "secret");
+        std::vector<bool> seen(count, false);
+        size_t collisions = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t pos = order.at(i);
+            REQUIRE(pos < count);
+            collisions += seen[pos];
+            seen[pos] = true;
+        }
+        CHECK(collisions == 0);
+    }
+
+    SUBCASE("Empty key keeps sequential order")
+    {
+        ScatterOrder order(1000, "");
+        CHECK_FALSE(order.keyed());
+        CHECK(order.at(0) == 0);
+        CHECK(order.at(999) == 999);
+    }
+
+    SUBCASE("Keyed LSB, QIM and CD round trip")
+    {
+        const std::string original_img = "test_scatter.png";
+        const std::string stego_img = "stego_scatter.png";
+        const std::string msg_file = "test_scatter_msg.txt";
+        const std::string output_file = "output_scatter_msg.txt";
+        create_test_file(msg_file, "Message");
+        create_test_image(original_img, 256, 256, 3);
+
+        REQUIRE_NOTHROW(lsb_embed(original_img, stego_img, msg_file, "k1"));
+        REQUIRE_NOTHROW(lsb_extract(stego_img, output_file, "k1"));
+        CHECK(read_file_to_string(output_file) == "Message");
+
+        REQUIRE_NOTHROW(qim_embed(original_img, stego_img, msg_file, "4", "k2"));
+        REQUIRE_NOTHROW(qim_extract(stego_img, "4", output_file, "k2"));
+        CHECK(read_file_to_string(output_file) == "Message");
+
+        REQUIRE_NOTHROW(cd_embed(original_img, stego_img, msg_file, "k3"));
+        REQUIRE_NOTHROW(cd_extract(stego_img, output_file, "k3"));
+        CHECK(read_file_to_string(output_file) == "Message");
+
+        std::filesystem::remove(original_img);
+        std::filesystem::remove(stego_img);
+        std::filesystem::remove(msg_file);
+        std::filesystem::remove(output_file);
+    }
+}
+
+TEST_CASE("Testing image I/O helpers")
+{
+    const std::string image = "test_io.png";
+    std::vector<unsigned char> pixels(8 * 4 * 3);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = static_cast<unsigned char>(i);
+
+    REQUIRE(write_image(image, 8, 4, 3, pixels.data()));
+
+    int w = 0, h = 0, c = 0;
+    CHECK(image_info(image, &w, &h, &c));
+    CHECK(w == 8);
+    CHECK(h == 4);
+
+    unsigned char *loaded = load_image(image, &w, &h, &c, 0);
+    REQUIRE(loaded != nullptr);
+    CHECK(std::equal(pixels.begin(), pixels.end(), loaded));
+    stbi_image_free(loaded);
+
+    const std::string binary("a\0b\nc", 5);
+    write_file("test_io.bin", binary);
+    CHECK(read_file_to_string("test_io.bin") == binary);
+
+    std::filesystem::remove(image);
+    std::filesystem::remove("test_io.bin");
+}
+
+TEST_CASE("Testing kernel-assisted file copy and mapping")
+{
+    const std::string src = "test_copy_src.bin";
+    const std::string dst = "test_copy_dst.bin";
+    std::string content(3 * 1024 * 1024 + 17, '\0');
+    for (size_t i = 0; i < content.size(); ++i)
+        content[i] = static_cast<char>(i * 131);
+    create_test_file(src, content);
+
+    REQUIRE_NOTHROW(copy_file_contents(src, dst));
+    MappedFile mapped(dst);
+    REQUIRE(mapped.size() == content.size());
+    CHECK(std::equal(content.begin(), content.end(), mapped.data()));
+
+    CHECK_THROWS_AS(copy_file_contents("non_existent_file.bin", dst), std::runtime_error);
+    CHECK_THROWS_AS(MappedFile("non_existent_file.bin"), std::runtime_error);
+
+    std::filesystem::remove(src);
+    std::filesystem::remove(dst);
+}
+
+TEST_CASE("Testing k-bit LSB steganography")
+{
+    const std::string original_img = "test_lsbk.png";
+    const std::string stego_img = "stego_lsbk.png";
+    const std::string msg_file = "test_lsbk_msg.txt";
+    const std::string output_file = "output_lsbk_msg.txt";
+
+    std::string message;
+    for (int i = 0; i < 700; ++i)
+        message += static_cast<char>('A' + i % 26);
+    create_test_file(msg_file, message);
+    create_test_image(original_img, 40, 40, 3);
+
+    SUBCASE("Symbols pack back to the same bytes")
+    {
+        const std::string data("\x01\x80\xff\x5a\x00\x37\xc3\x96", 8);
+        for (int bits = 1; bits <= 4; ++bits)
+        {
+            // Lengths that are not a multiple of three leave a tail after the whole k = 3 groups
+            for (size_t length = 0; length <= data.size(); ++length)
+            {
+                std::vector<unsigned char> symbols = unpack_symbols(data.substr(0, length), bits);
+                CHECK(pack_symbols(symbols.data(), symbols.size(), bits) == data.substr(0, length));
+            }
+        }
+        CHECK(unpack_symbols("\x05\x39\x77", 3) == std::vector<unsigned char>{0, 1, 2, 3, 4, 5, 6, 7});
+    }
+
+    SUBCASE("Embedding and extraction for k = 2..4")
+    {
+        for (int bits = 2; bits <= 4; ++bits)
+        {
+            REQUIRE_NOTHROW(lsb_embed(original_img, stego_img, msg_file, "", bits));
+            REQUIRE_NOTHROW(lsb_extract(stego_img, output_file, "", bits));
+            CHECK(read_file_to_string(output_file) == message);
+
+            REQUIRE_NOTHROW(lsb_embed(original_img, stego_img, msg_file, "key", bits));
+            REQUIRE_NOTHROW(lsb_extract(stego_img, output_file, "key", bits));
+            CHECK(read_file_to_string(output_file) == message);
+        }
+    }
+
+    SUBCASE("Capacity grows with k")
+    {
+        CHECK(lsb_capacity(original_img, 1) == 40 * 40 * 3 / 8 - 1);
+        CHECK(lsb_capacity(original_img, 4) == 40 * 40 * 3 / 2 - 1);
+        CHECK_THROWS_AS(lsb_embed(original_img, stego_img, msg_file, "", 1), std::runtime_error);
+        CHECK_THROWS_AS(lsb_embed(original_img, stego_img, msg_file, "", 5), std::runtime_error);
+    }
+
+    std::filesystem::remove(original_img);
+    std::filesystem::remove(stego_img);
+    std::filesystem::remove(msg_file);
+    std::filesystem::remove(output_file);
+}
+
+TEST_CASE("Testing animated GIF steganography")
+{
+    const std::string original_gif = "test_anim.gif";
+    const std::string stego_png = "stego_anim.png";
+    const std::string msg_file = "test_anim_msg.bin";
+    const std::string output_file = "output_anim_msg.bin";
+
+    create_test_gif(original_gif, 24, 16, 5);
+    std::string message;
+    for (int i = 0; i < 900; ++i)
+        message += static_cast<char>(i * 13);
+    create_test_file(msg_file, message);
+
+    SUBCASE("Capacity scales with frame count")
+    {
+        CHECK(gif_capacity(original_gif, 1) == 24 * 16 * 3 / 8 * 5 - 8);
+        CHECK(gif_capacity(original_gif, 2) == 24 * 16 * 3 * 2 / 8 * 5 - 8);
+    }
+
+    SUBCASE("Payload spread over frames")
+    {
+        REQUIRE_NOTHROW(gif_embed(original_gif, stego_png, msg_file, 2));
+        REQUIRE_NOTHROW(gif_extract(stego_png, output_file, 2));
+        CHECK(read_file_to_string(output_file) == message);
+
+        int w, h, c;
+        unsigned char *first = stbi_load(stego_png.c_str(), &w, &h, &c, 4);
+        REQUIRE(first != nullptr);
+        CHECK(w == 24);
+        CHECK(h == 16);
+        stbi_image_free(first);
+    }
+
+    SUBCASE("Message too large")
+    {
+        CHECK_THROWS_AS(gif_embed(original_gif, stego_png, msg_file, 1), std::runtime_error);
+    }
+
+    SUBCASE("Frame control before IHDR is rejected")
+    {
+        std::string apng("\x89PNG\r\n\x1a\n", 8);
+        char length[4];
+        put_be32(length, 26);
+        apng += std::string(length, 4) + "fcTL" + std::string(26 + 4, '\0');
+        apng += std::string(4, '\0') + "IEND" + std::string(4, '\0');
+        create_test_file(stego_png, apng);
+        CHECK_THROWS_AS(gif_extract(stego_png, output_file, 1), std::runtime_error);
+    }
+
+    std::filesystem::remove(original_gif);
+    std::filesystem::remove(stego_png);
+    std::filesystem::remove(msg_file);
+    std::filesystem::remove(output_file);
+}
+
+TEST_CASE("Testing steganalysis scanner")
+{
+    // Natural photo: synthetic gradients have flat histograms and look embedded to the pairs test
+    const std::string original_img = "original.png";
+    const std::string full_img = "stego_analysis_full.png";
+    const std::string half_img = "stego_analysis_half.png";
+    const std::string msg_file = "test_analysis_msg.bin";
+
+    const size_t capacity = lsb_capacity(original_img);
+    std::string message;
+    uint32_t state = 12345;
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        message += static_cast<char>(state >> 24);
+    }
+    create_test_file(msg_file, message);
+    REQUIRE_NOTHROW(lsb_embed(original_img, full_img, msg_file));
+    create_test_file(msg_file, message.substr(0, capacity / 2));
+    REQUIRE_NOTHROW(lsb_embed(original_img, half_img, msg_file));
+
+    SUBCASE("Clean image scores low")
+    {
+        StegAnalysis clean = analyze_image(original_img);
+        CHECK(clean.channels == 3);
+        CHECK(clean.chi_square_p < 0.05);
+        CHECK(clean.estimated_rate < 0.1);
+    }
+
+    SUBCASE("Embedding rate is estimated")
+    {
+        StegAnalysis full = analyze_image(full_img);
+        CHECK(full.chi_square_p > 0.95);
+        CHECK(full.estimated_rate > 0.9);
+
+        StegAnalysis half = analyze_image(half_img);
+        CHECK(half.rs_rate > 0.35);
+        CHECK(half.rs_rate < 0.65);
+    }
+
+    SUBCASE("Batch keeps order and matches single image analysis")
+    {
+        std::vector<StegAnalysis> batch = analyze_images({original_img, full_img});
+        REQUIRE(batch.size() == 2);
+        CHECK(batch[1].rs_rate == doctest::Approx(analyze_image(full_img, 1).rs_rate));
+        uint64_t total = 0;
+        for (uint64_t count : batch[0].histograms[0])
+            total += count;
+        CHECK(total == static_cast<uint64_t>(batch[0].width) * batch[0].height);
+        CHECK(analysis_to_json(batch[0]).find("\"image\":\"original.png\"") != std::string::npos);
+    }
+
+    std::filesystem::remove(full_img);
+    std::filesystem::remove(half_img);
+    std::filesystem::remove(msg_file);
+}
+
+TEST_CASE("Testing phase statistics")
+{
+    const std::string original_img = "test_stats.png";
+    const std::string stego_img = "stego_stats.png";
+    const std::string msg_file = "test_stats_msg.txt";
+    const std::string output_file = "output_stats_msg.txt";
+    const std::string message = "Phase statistics";
+
+    create_test_file(msg_file, message);
+    create_test_image(original_img, 32, 32, 3);
+
+    stats_reset();
+    stats_enable(true);
+    lsb_embed(original_img, stego_img, msg_file);
+    lsb_extract(stego_img, output_file);
+    stats_enable(false);
+
+    SUBCASE("Every phase of embedding and extraction is timed")
+    {
+        for (StatPhase phase : {PHASE_READ, PHASE_DECODE, PHASE_MESSAGE, PHASE_EMBED, PHASE_EXTRACT, PHASE_ENCODE,
+                                PHASE_WRITE})
+            CHECK(stats_phase_calls(phase) >= 1);
+        CHECK(stats_phase_calls(PHASE_DECODE) == 2);
+        CHECK(stats_phase_calls(PHASE_ANALYZE) == 0);
+    }
+
+    SUBCASE("Counters")
+    {
+        CHECK(stats_counter(BYTES_READ) >= message.size());
+        CHECK(stats_counter(BYTES_WRITTEN) >= message.size() + std::filesystem::file_size(stego_img));
+        CHECK(stats_counter(PIXELS_TOUCHED) >= (message.size() + 1) * 8 * 2);
+        // Heap allocations are counted by the allocator hook linked only into stego_program
+        CHECK(stats_counter(ALLOCATIONS) == 0);
+        stats_enable(true);
+        stats_add(ALLOCATIONS, 1);
+        stats_enable(false);
+        CHECK(stats_counter(ALLOCATIONS) == 1);
+    }
+
+    SUBCASE("Disabled statistics do not change")
+    {
+        const uint64_t reads = stats_counter(BYTES_READ);
+        lsb_extract(stego_img, output_file);
+        CHECK(stats_counter(BYTES_READ) == reads);
+    }
+
+    SUBCASE("JSON report")
+    {
+        const std::string json = stats_to_json("lsb e");
+        CHECK(json.find("\"command\":\"lsb e\"") != std::string::npos);
+        CHECK(json.find("\"embed\":{\"calls\":1") != std::string::npos);
+        CHECK(json.find("\"analyze\"") == std::string::npos);
+        CHECK(json.find("\"pixels_touched\":") != std::string::npos);
+    }
+
+    SUBCASE("Hardware counters degrade gracefully")
+    {
+        stats_reset();
+        stats_enable(true);
+        const bool available = perf_counters_enable(true);
+        CHECK(perf_counters_enabled() == available);
+        REQUIRE_NOTHROW(lsb_embed(original_img, stego_img, msg_file));
+        const std::string json = stats_to_json("lsb e");
+        if (available)
+        {
+            CHECK(json.find("\"ipc\":") != std::string::npos);
+            // Worker threads open their own groups and never undo the main thread's status
+            parallel_for(8, [](size_t) { PhaseTimer timer(PHASE_ANALYZE); }, 4);
+            CHECK(perf_counters_status().rfind("unavailable", 0) != 0);
+        }
+        else
+        {
+            CHECK(perf_counters_status().rfind("unavailable", 0) == 0);
+            CHECK(json.find("\"ipc\":") == std::string::npos);
+        }
+        perf_counters_enable(false);
+        stats_enable(false);
+        CHECK(perf_counters_status() == "disabled");
+    }
+
+    stats_reset();
+    std::filesystem::remove(original_img);
+    std::filesystem::remove(stego_img);
+    std::filesystem::remove(msg_file);
+    std::filesystem::remove(output_file);
+}
+
+TEST_CASE("Testing verify-after-embed")
+{
+    const std::string original_img = "test_verify.png";
+    const std::string stego_img = "stego_verify.png";
+    const std::string msg_file = "test_verify_msg.txt";
+    const std::string message = "Verified before encoding";
+
+    create_test_file(msg_file, message);
+    create_test_image(original_img, 32, 32, 3);
+    embed_verify_enable(true);
+
+    SUBCASE("Round trips pass verification")
+    {
+        CHECK_NOTHROW(lsb_embed(original_img, stego_img, msg_file, "key", 2));
+        CHECK_NOTHROW(qim_embed(original_img, stego_img, msg_file, "8", "key"));
+
+        std::vector<unsigned char> rgb(32 * 32 * 3);
+        for (size_t i = 0; i < rgb.size(); ++i)
+            rgb[i] = static_cast<unsigned char>(50 + 50 * (i % 3));
+        CHECK_NOTHROW(ChannelSwapping().embed(rgb.data(), 32 * 32, message));
+        CHECK_NOTHROW(MidBitChange().embed(rgb.data(), 32 * 32, message));
+    }
+
+    SUBCASE("Channel swapping cannot order equal channels")
+    {
+        std::vector<unsigned char> flat(32 * 32 * 3, 128);
+        CHECK_THROWS_AS(ChannelSwapping().embed(flat.data(), 32 * 32, message), std::runtime_error);
+    }
+
+    SUBCASE("Truncated QIM message is caught")
+    {
+        std::vector<unsigned char> pixels(64, 100);
+        CHECK_THROWS_AS(qim_embed_pixels(pixels.data(), pixels.size(), message, 8), std::runtime_error);
+        embed_verify_enable(false);
+        CHECK_NOTHROW(qim_embed_pixels(pixels.data(), pixels.size(), message, 8));
+    }
+
+    SUBCASE("EOF tail is re-read")
+    {
+        EOFHiding eof;
+        CHECK_NOTHROW(eof.encode(original_img, message, stego_img));
+        CHECK(eof.decode(stego_img, message.size()) == message);
+    }
+
+    embed_verify_enable(false);
+    std::filesystem::remove(original_img);
+    std::filesystem::remove(stego_img);
+    std::filesystem::remove(msg_file);
+}
+
+TEST_CASE("Testing in-pass distortion metrics")
+{
+    const std::string message = "Distortion";
+    std::vector<unsigned char> pixels(4096);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = static_cast<unsigned char>(i * 7);
+
+    // Reference metrics from a before/after comparison of the whole buffer
+    auto reference = [](const std::vector<unsigned char> &a, const std::vector<unsigned char> &b) {
+        DistortionTotals totals;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            const int delta = b[i] - a[i];
+            totals.sse += static_cast<uint64_t>(delta * delta);
+            totals.changed += delta != 0;
+            totals.max_delta = std::max(totals.max_delta, static_cast<unsigned>(std::abs(delta)));
+        }
+        totals.samples = a.size();
+        return totals;
+    };
+    auto check_against = [](const DistortionTotals &expected) {
+        const DistortionTotals totals = distortion_totals();
+        CHECK(totals.sse == expected.sse);
+        CHECK(totals.changed == expected.changed);
+        CHECK(totals.max_delta == expected.max_delta);
+        CHECK(totals.samples == expected.samples);
+    };
+
+    distortion_reset();
+    distortion_enable(true);
+
+    SUBCASE("Vector and scattered LSB")
+    {
+        for (const std::string key : {"", "key"})
+        {
+            std::vector<unsigned char> stego = pixels;
+            lsb_embed_pixels(stego.data(), stego.size(), message, key, 3);
+            check_against(reference(pixels, stego));
+            distortion_reset();
+        }
+    }
+
+    SUBCASE("QIM, CD, channel swapping and mid bit")
+    {
+        std::vector<unsigned char> stego = pixels;
+        qim_embed_pixels(stego.data(), stego.size(), message, 16);
+        check_against(reference(pixels, stego));
+        CHECK(distortion_totals().max_delta >= 8);
+        distortion_reset();
+
+        stego = pixels;
+        cd_embed_pixels(stego.data(), stego.size() / 4, 4, message);
+        check_against(reference(pixels, stego));
+        distortion_reset();
+
+        std::vector<unsigned char> rgb(pixels.begin(), pixels.begin() + 3000);
+        stego = rgb;
+        ChannelSwapping().embed(stego.data(), 1000, message);
+        check_against(reference(rgb, stego));
+        distortion_reset();
+
+        stego = rgb;
+        MidBitChange().embed(stego.data(), 1000, message);
+        check_against(reference(rgb, stego));
+        CHECK(distortion_totals().max_delta == 16);
+    }
+
+    SUBCASE("PSNR and JSON")
+    {
+        std::vector<unsigned char> stego = pixels;
+        lsb_embed_pixels(stego.data(), stego.size(), message, "", 1);
+        const DistortionTotals totals = distortion_totals();
+        const double mse = static_cast<double>(totals.sse) / totals.samples;
+        CHECK(distortion_psnr(totals) == doctest::Approx(10.0 * std::log10(255.0 * 255.0 / mse)));
+        CHECK(distortion_to_json().find("\"psnr_db\":") != std::string::npos);
+
+        distortion_reset();
+        CHECK(std::isinf(distortion_psnr(distortion_totals())));
+        CHECK(distortion_to_json().find("\"psnr_db\":null") != std::string::npos);
+    }
+
+    SUBCASE("Disabled metrics stay at zero")
+    {
+        distortion_enable(false);
+        std::vector<unsigned char> stego = pixels;
+        lsb_embed_pixels(stego.data(), stego.size(), message, "", 2);
+        CHECK(distortion_totals().samples == 0);
+    }
+
+    distortion_enable(false);
+    distortion_reset();
+}
+
+TEST_CASE("Testing decoded carrier cache")
+{
+    const std::string cache = "test_carrier_cache";
+    const std::string original_img = "test_cache.png";
+    const std::string stego_img = "stego_cache.png";
+    const std::string msg_file = "test_cache_msg.txt";
+    const std::string output_file = "output_cache_msg.txt";
+    const std::string message = "Served from the sidecar";
+
+    create_test_file(msg_file, message);
+    create_test_image(original_img, 48, 40, 3);
+    std::filesystem::remove_all(cache);
+    carrier_cache_configure(cache, 0);
+    stats_reset();
+    stats_enable(true);
+
+    SUBCASE("Second load hits the sidecar with identical pixels")
+    {
+        int w1, h1, c1, w2, h2, c2;
+        unsigned char *first = load_image(original_img, &w1, &h1, &c1, 0);
+        REQUIRE(first != nullptr);
+        CHECK(stats_counter(CACHE_MISSES) == 1);
+        unsigned char *second = load_image(original_img, &w2, &h2, &c2, 0);
+        REQUIRE(second != nullptr);
+        CHECK(stats_counter(CACHE_HITS) == 1);
+        CHECK((w1 == w2 && h1 == h2 && c1 == c2));
+        CHECK(std::equal(first, first + w1 * h1 * c1, second));
+        stbi_image_free(first);
+        stbi_image_free(second);
+
+        // Requested channel count is part of the key
+        unsigned char *rgba = load_image(original_img, &w2, &h2, &c2, 4);
+        REQUIRE(rgba != nullptr);
+        CHECK(c2 == 3);
+        CHECK(stats_counter(CACHE_MISSES) == 2);
+        stbi_image_free(rgba);
+    }
+
+    SUBCASE("Round trip through cached carriers")
+    {
+        for (int run = 0; run < 2; ++run)
+        {
+            REQUIRE_NOTHROW(lsb_embed(original_img, stego_img, msg_file));
+            REQUIRE_NOTHROW(lsb_extract(stego_img, output_file));
+            CHECK(read_file_to_string(output_file) == message);
+        }
+        CHECK(stats_counter(CACHE_HITS) >= 1);
+    }
+
+    SUBCASE("Rewritten source invalidates its sidecar")
+    {
+        int w, h, c;
+        stbi_image_free(load_image(original_img, &w, &h, &c, 0));
+        create_test_image(original_img, 20, 10, 3);
+        std::filesystem::last_write_time(original_img, std::filesystem::last_write_time(original_img) +
+                                                           std::chrono::seconds(5));
+        unsigned char *data = load_image(original_img, &w, &h, &c, 0);
+        REQUIRE(data != nullptr);
+        CHECK((w == 20 && h == 10));
+        CHECK(stats_counter(CACHE_HITS) == 0);
+        stbi_image_free(data);
+    }
+
+    SUBCASE("Size limit evicts old sidecars")
+    {
+        // Room for the RGBA sidecar alone, the older RGB one has to go
+        carrier_cache_configure(cache, 48 * 40 * 4 + 100);
+        int w, h, c;
+        stbi_image_free(load_image(original_img, &w, &h, &c, 0));
+        stbi_image_free(load_image(original_img, &w, &h, &c, 4));
+        size_t sidecars = 0;
+        for (const auto &entry : std::filesystem::directory_iterator(cache))
+            sidecars += entry.path().extension() == ".raw";
+        CHECK(sidecars == 1);
+        stbi_image_free(load_image(original_img, &w, &h, &c, 4));
+        CHECK(stats_counter(CACHE_HITS) == 1);
+    }
+
+    stats_enable(false);
+    stats_reset();
+    carrier_cache_configure("", 0);
+    std::filesystem::remove_all(cache);
+    std::filesystem::remove(original_img);
+    std::filesystem::remove(stego_img);
+    std::filesystem::remove(msg_file);
+    std::filesystem::remove(output_file);
+}
+
+TEST_CASE("Testing multiple payloads in disjoint regions")
+{
+    const std::vector<std::string> payloads = {"token for alice", std::string("bob\0bytes", 9), "", "carol"};
+    std::vector<unsigned char> pixels(2000);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = static_cast<unsigned char>(i * 13);
+
+    SUBCASE("Every payload comes back on its own")
+    {
+        for (const std::string method : {"lsb", "qim"})
+        {
+            for (const std::string key : {"", "key"})
+            {
+                const int param = method == "lsb" ? 3 : 8;
+                std::vector<unsigned char> stego = pixels;
+                REQUIRE_NOTHROW(multi_embed_pixels(stego.data(), stego.size(), payloads, method, param, key));
+                for (size_t i = 0; i < payloads.size(); ++i)
+                    CHECK(multi_extract_pixels(stego.data(), stego.size(), i, method, param, key) == payloads[i]);
+                CHECK_THROWS_AS(multi_extract_pixels(stego.data(), stego.size(), payloads.size(), method, param, key),
+                                std::runtime_error);
+            }
+        }
+    }
+
+    SUBCASE("Odd QIM steps on a saturated carrier")
+    {
+        for (int q : {3, 5, 7})
+        {
+            std::vector<unsigned char> stego(pixels.size(), 255);
+            REQUIRE_NOTHROW(multi_embed_pixels(stego.data(), stego.size(), payloads, "qim", q));
+            for (size_t i = 0; i < payloads.size(); ++i)
+                CHECK(multi_extract_pixels(stego.data(), stego.size(), i, "qim", q) == payloads[i]);
+        }
+    }
+
+    SUBCASE("Damage in one region leaves the others readable")
+    {
+        std::vector<unsigned char> stego = pixels;
+        multi_embed_pixels(stego.data(), stego.size(), payloads, "lsb", 1);
+        // Table is 6 + 4 * 8 bytes, the first region starts right after it
+        const size_t first_region = (6 + 4 * 8) * 8;
+        stego[first_region] ^= 1;
+        CHECK_THROWS_AS(multi_extract_pixels(stego.data(), stego.size(), 0, "lsb", 1), std::runtime_error);
+        CHECK(multi_extract_pixels(stego.data(), stego.size(), 3, "lsb", 1) == payloads[3]);
+    }
+
+    SUBCASE("Capacity, methods and missing tables")
+    {
+        std::vector<unsigned char> stego = pixels;
+        CHECK_THROWS_AS(multi_embed_pixels(stego.data(), stego.size(), {std::string(300, 'x')}, "lsb", 1),
+                        std::runtime_error);
+        CHECK_THROWS_AS(multi_embed_pixels(stego.data(), stego.size(), payloads, "cd", 1), std::runtime_error);
+        CHECK_THROWS_AS(multi_extract_pixels(pixels.data(), pixels.size(), 0, "lsb", 1), std::runtime_error);
+    }
+
+    SUBCASE("File round trip")
+    {
+        const std::string original_img = "test_multi.png";
+        const std::string stego_img = "stego_multi.png";
+        const std::vector<std::string> msg_files = {"test_multi_0.txt", "test_multi_1.txt"};
+        create_test_image(original_img, 40, 30, 3);
+        create_test_file(msg_files[0], payloads[0]);
+        create_test_file(msg_files[1], payloads[1]);
+
+        REQUIRE_NOTHROW(multi_embed("lsb", original_img, stego_img, msg_files, 2, "key"));
+        CHECK(multi_extract("lsb", stego_img, 1, 2, "key") == payloads[1]);
+        CHECK(multi_extract("lsb", stego_img, 0, 2, "key") == payloads[0]);
+
+        std::filesystem::remove(original_img);
+        std::filesystem::remove(stego_img);
+        for (const auto &file : msg_files)
+            std::filesystem::remove(file);
+    }
+}
+
+TEST_CASE("Testing content-adaptive embedding")
+{
+    const int width = 64, height = 48, channels = 3;
+    // Left half is flat, right half is a checkerboard with strong edges
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * channels);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            for (int c = 0; c < channels; ++c)
+                pixels[(static_cast<size_t>(y) * width + x) * channels + c] =
+                    static_cast<unsigned char>(x < width / 2 ? 120 : ((x / 2 + y / 2) % 2 ? 200 : 40));
+    const std::string message = "Hidden where the texture is";
+
+    SUBCASE("Round trip for every method and key")
+    {
+        const std::vector<std::pair<std::string, int>> methods = {{"lsb", 2}, {"qim", 8}, {"qim", 6}, {"cd", 0}};
+        for (const auto &[method, param] : methods)
+        {
+            for (const std::string key : {"", "key"})
+            {
+                std::vector<unsigned char> stego = pixels;
+                REQUIRE_NOTHROW(adaptive_embed_pixels(stego.data(), width, height, channels, message, method, param,
+                                                      100, key));
+                CHECK(adaptive_extract_pixels(stego.data(), width, height, channels, method, param, 100, key) ==
+                      message);
+            }
+        }
+    }
+
+    SUBCASE("Odd QIM steps on saturated pixels keep the map")
+    {
+        // 255 is the base of a one-value cell for q = 3 and 5, embedding must not wrap it to 0 or 1
+        std::vector<unsigned char> saturated = pixels;
+        for (auto &v : saturated)
+            v = v == 200 ? 255 : v == 40 ? 0 : v;
+        for (int q : {3, 5, 7, 9})
+        {
+            for (const std::string key : {"", "key"})
+            {
+                std::vector<unsigned char> stego = saturated;
+                REQUIRE_NOTHROW(adaptive_embed_pixels(stego.data(), width, height, channels, message, "qim", q, 100,
+                                                      key));
+                CHECK(adaptive_extract_pixels(stego.data(), width, height, channels, "qim", q, 100, key) == message);
+                CHECK(adaptive_capacity(stego.data(), width, height, channels, "qim", q, 100) ==
+                      adaptive_capacity(saturated.data(), width, height, channels, "qim", q, 100));
+                int max_delta = 0;
+                for (size_t i = 0; i < stego.size(); ++i)
+                    max_delta = std::max(max_delta, std::abs(stego[i] - saturated[i]));
+                // A merged top cell spans less than two steps
+                CHECK(max_delta < 2 * q);
+            }
+        }
+    }
+
+    SUBCASE("QIM kernels match the scalar cells")
+    {
+        // Every value twice, once per symbol, so the vector body and the scalar tail both see all of them
+        std::vector<unsigned char> values(515), symbols(values.size()), read(values.size());
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            values[i] = static_cast<unsigned char>(i % 256);
+            symbols[i] = static_cast<unsigned char>(i / 256 % 2);
+        }
+        std::vector<int> mismatched;
+        for (int q = 2; q <= 256; ++q)
+        {
+            const int top = 255 / q * q + q / 2 > 255 ? 255 / q * q - q : 255 / q * q;
+            std::vector<unsigned char> stego = values;
+            qim_insert_bits(stego.data(), symbols.data(), stego.size(), q, top);
+            qim_collect_bits(stego.data(), read.data(), read.size(), q, top);
+            bool same = read == symbols;
+            for (size_t i = 0; i < values.size(); ++i)
+                same &= stego[i] == std::min(values[i] / q * q, top) + q / 2 * symbols[i];
+            if (!same)
+                mismatched.push_back(q);
+        }
+        CHECK(mismatched.empty());
+    }
+
+    SUBCASE("Map from the analysis pass serves embedding and extraction")
+    {
+        // Taller than one band of rows, so the map is stitched from several
+        const int tall = 150;
+        std::vector<unsigned char> carrier(static_cast<size_t>(width) * tall * channels);
+        for (size_t i = 0; i < carrier.size(); ++i)
+            carrier[i] = static_cast<unsigned char>(i * 2654435761u >> 24);
+        for (const auto &[method, param] : std::vector<std::pair<std::string, int>>{{"lsb", 1}, {"qim", 3}, {"cd", 0}})
+        {
+            const AdaptiveMap map = adaptive_map(carrier.data(), width, tall, channels, method, param, 100);
+            CHECK(map.total * (method == "lsb" ? param : 1) / 8 - 1 ==
+                  adaptive_capacity(carrier.data(), width, tall, channels, method, param, 100));
+            std::vector<unsigned char> stego = carrier;
+            REQUIRE_NOTHROW(adaptive_embed_pixels(stego.data(), map, message));
+            CHECK(adaptive_extract_pixels(stego.data(), map) == message);
+            CHECK(adaptive_extract_pixels(stego.data(), width, tall, channels, method, param, 100) == message);
+        }
+    }
+
+    SUBCASE("Flat region is never touched")
+    {
+        std::vector<unsigned char> stego = pixels;
+        adaptive_embed_pixels(stego.data(), width, height, channels, message, "lsb", 1, 100, "key");
+        bool flat_changed = false;
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width / 2 - 1; ++x)
+                for (int c = 0; c < channels; ++c)
+                {
+                    const size_t i = (static_cast<size_t>(y) * width + x) * channels + c;
+                    flat_changed |= stego[i] != pixels[i];
+                }
+        CHECK_FALSE(flat_changed);
+        CHECK(stego != pixels);
+    }
+
+    SUBCASE("Map comes from bits the method keeps")
+    {
+        std::vector<unsigned char> noisy = pixels;
+        for (size_t i = 0; i < noisy.size(); ++i)
+            noisy[i] = static_cast<unsigned char>((noisy[i] & ~3) | (i * 7 % 4));
+        for (int threshold : {0, 100, 1000})
+            CHECK(adaptive_capacity(noisy.data(), width, height, channels, "lsb", 2, threshold) ==
+                  adaptive_capacity(pixels.data(), width, height, channels, "lsb", 2, threshold));
+    }
+
+    SUBCASE("Command line with --adaptive")
+    {
+        const std::string carrier = "test_adaptive_cli.png", stego = "stego_adaptive_cli.png";
+        const std::string msg_file = "test_adaptive_cli.txt", output_file = "output_adaptive_cli.txt";
+        REQUIRE(write_image(carrier, width, height, channels, pixels.data()));
+        create_test_file(msg_file, message);
+
+        // qim e <message> <carrier> <stego> <q>, then qim x <stego> <output> <q>
+        REQUIRE(run_program("qim e " + msg_file + " " + carrier + " " + stego + " 8 --adaptive 100") == 0);
+        REQUIRE(run_program("qim x " + stego + " " + output_file + " 8 --adaptive 100") == 0);
+        CHECK(read_file_to_string(output_file) == message);
+
+        // Capacity with --adaptive counts only the textured slots, the flag is refused where it has no meaning
+        REQUIRE(run_program("qim c " + carrier + " 8 --adaptive 100 > " + output_file) == 0);
+        CHECK(std::stoull(read_file_to_string(output_file)) ==
+              adaptive_capacity(pixels.data(), width, height, channels, "qim", 8, 100));
+        REQUIRE(run_program("lsb c " + carrier + " --bits 2 --adaptive 100 > " + output_file) == 0);
+        CHECK(std::stoull(read_file_to_string(output_file)) ==
+              adaptive_capacity(pixels.data(), width, height, channels, "lsb", 2, 100));
+        REQUIRE(run_program("cs c " + carrier + " --adaptive 100 > " + output_file + " 2>&1") == 0);
+        CHECK(read_file_to_string(output_file).rfind("Error:", 0) == 0);
+
+        for (const auto &path : {carrier, stego, msg_file, output_file})
+            std::filesystem::remove(path);
+    }
+
+    SUBCASE("Capacity shrinks with the threshold")
+    {
+        const size_t all = adaptive_capacity(pixels.data(), width, height, channels, "lsb", 1, 0);
+        const size_t textured = adaptive_capacity(pixels.data(), width, height, channels, "lsb", 1, 100);
+        CHECK(all == (static_cast<size_t>(width - 2) * (height - 2) * channels / 8 - 1));
+        CHECK(textured < all);
+        CHECK(textured > 0);
+        CHECK(adaptive_capacity(pixels.data(), width, height, channels, "lsb", 1, 30000) == 0);
+        std::vector<unsigned char> stego = pixels;
+        CHECK_THROWS_AS(adaptive_embed_pixels(stego.data(), width, height, channels, std::string(textured + 1, 'x'),
+                                              "lsb", 1, 100),
+                        std::runtime_error);
+        CHECK_THROWS_AS(adaptive_capacity(pixels.data(), width, height, channels, "cs", 1, 0), std::runtime_error);
+    }
+}
+
+TEST_CASE("Testing automatic method selection")
+{
+    const int width = 64, height = 48, channels = 3;
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * channels);
+    // Channels keep apart, so CD picks the same channel before and after its LSB change
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = static_cast<unsigned char>((i % 3 == 2 ? 200 : i % 3 * 60) + i * 37 % 21);
+    const std::string message = "Picked by the throughput model";
+    auto psnr = [&](const std::vector<unsigned char> &stego) {
+        DistortionTotals totals;
+        totals.samples = pixels.size();
+        for (size_t i = 0; i < pixels.size(); ++i)
+            totals.sse += static_cast<uint64_t>((stego[i] - pixels[i]) * (stego[i] - pixels[i]));
+        return distortion_psnr(totals);
+    };
+
+    SUBCASE("Fastest fitting method round trips without parameters")
+    {
+        for (const std::string key : {"", "key"})
+        {
+            std::vector<unsigned char> stego = pixels;
+            const AutoChoice choice = auto_embed_pixels(stego.data(), width, height, channels, message, 0, key);
+            CHECK(auto_choice_name(choice) == "lsb 1");
+            CHECK(auto_extract_pixels(stego.data(), width, height, channels, key) == message);
+        }
+    }
+
+    SUBCASE("Binary payloads go to methods that carry zero bytes")
+    {
+        const std::string binary("bin\0ary\0", 8);
+        std::vector<unsigned char> stego = pixels;
+        const AutoChoice choice = auto_embed_pixels(stego.data(), width, height, channels, binary);
+        CHECK(auto_choice_name(choice) == "mbc");
+        CHECK(auto_extract_pixels(stego.data(), width, height, channels) == binary);
+
+        // CS and MBC need plain RGB
+        std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4, 100);
+        CHECK_THROWS_AS(auto_embed_pixels(rgba.data(), width, height, 4, binary), std::runtime_error);
+        CHECK(auto_choice_name(auto_embed_pixels(rgba.data(), width, height, 4, message)) == "lsb 1");
+        CHECK(auto_extract_pixels(rgba.data(), width, height, 4) == message);
+    }
+
+    SUBCASE("Distortion bound moves to a gentler method")
+    {
+        const std::string large(600, 'q');
+        std::vector<unsigned char> fast = pixels;
+        CHECK(auto_choice_name(auto_embed_pixels(fast.data(), width, height, channels, large, 0, "", 4)) == "lsb 4");
+        const double bound = psnr(fast) + 1;
+
+        std::vector<unsigned char> gentle = pixels;
+        const AutoChoice choice = auto_embed_pixels(gentle.data(), width, height, channels, large, bound, "", 4);
+        CHECK(auto_choice_name(choice) != "lsb 4");
+        CHECK(choice.psnr >= bound);
+        CHECK(psnr(gentle) == doctest::Approx(choice.psnr));
+        CHECK(auto_extract_pixels(gentle.data(), width, height, channels) == large);
+
+        std::vector<unsigned char> stego = pixels;
+        CHECK_THROWS_AS(auto_embed_pixels(stego.data(), width, height, channels, large, 200, "", 4),
+                        std::runtime_error);
+        CHECK(stego == pixels);
+    }
+
+    SUBCASE("Oversized message throws")
+    {
+        std::vector<unsigned char> stego = pixels;
+        CHECK(auto_candidates(width, height, channels, std::string(pixels.size(), 'x'), 4).empty());
+        CHECK_THROWS_AS(auto_embed_pixels(stego.data(), width, height, channels, std::string(pixels.size(), 'x')),
+                        std::runtime_error);
+    }
+
+    SUBCASE("Missing or damaged header is rejected")
+    {
+        CHECK_THROWS_AS(auto_extract_pixels(pixels.data(), width, height, channels), std::runtime_error);
+        std::vector<unsigned char> stego = pixels;
+        auto_embed_pixels(stego.data(), width, height, channels, message);
+        stego[130] ^= 1;
+        CHECK_THROWS_AS(auto_extract_pixels(stego.data(), width, height, channels), std::runtime_error);
+    }
+
+    SUBCASE("Throughput model from a benchmark file")
+    {
+        const std::string model_file = "auto_model_test.json";
+        write_file(model_file, "{\n  \"methods\": {\n"
+                               "    \"lsb\": {\"mbps\": 10.0, \"relative\": 0.0100},\n"
+                               "    \"lsb b=2\": {\"mbps\": 10.0, \"relative\": 0.0100},\n"
+                               "    \"lsb b=3\": {\"mbps\": 10.0, \"relative\": 0.0100},\n"
+                               "    \"lsb b=4\": {\"mbps\": 10.0, \"relative\": 0.0100},\n"
+                               "    \"qim q=4\": {\"mbps\": 10.0, \"relative\": 0.0100},\n"
+                               "    \"cd\": {\"mbps\": 9000.0, \"relative\": 9.0000},\n"
+                               "    \"cs\": {\"mbps\": 10.0, \"relative\": 0.0100},\n"
+                               "    \"mbc\": {\"mbps\": 10.0, \"relative\": 0.0100}\n  }\n}\n");
+        auto_model_load(model_file);
+        std::vector<unsigned char> stego = pixels;
+        CHECK(auto_choice_name(auto_embed_pixels(stego.data(), width, height, channels, message)) == "cd");
+        CHECK(auto_extract_pixels(stego.data(), width, height, channels) == message);
+
+        // Where CD loses bits the next method in cost order is used
+        std::vector<unsigned char> mixed(pixels.size());
+        for (size_t i = 0; i < mixed.size(); ++i)
+            mixed[i] = static_cast<unsigned char>((i * 37 + i / 7 * 11) % 256);
+        CHECK(auto_choice_name(auto_embed_pixels(mixed.data(), width, height, channels, message)) != "cd");
+        CHECK(auto_extract_pixels(mixed.data(), width, height, channels) == message);
+
+        auto_model_load("");
+        CHECK(auto_choice_name(auto_candidates(width, height, channels, message).front()) == "lsb 1");
+
+        // Every LSB depth is costed by its own benchmark row
+        write_file(model_file, "{\"methods\": {\"lsb\": {\"relative\": 1.0}, \"lsb b=2\": {\"relative\": 1.0}, "
+                               "\"lsb b=3\": {\"relative\": 0.0001}, \"lsb b=4\": {\"relative\": 1.0}, "
+                               "\"qim q=4\": {\"relative\": 0.2}, \"cd\": {\"relative\": 0.2}, "
+                               "\"cs\": {\"relative\": 0.2}, \"mbc\": {\"relative\": 0.2}}}");
+        auto_model_load(model_file);
+        CHECK(auto_choice_name(auto_candidates(width, height, channels, message, 2).front()) == "lsb 2");
+        CHECK(auto_choice_name(auto_candidates(width, height, channels, message, 3).front()) != "lsb 3");
+
+        write_file(model_file, "{\"methods\": {\"lsb\": {\"mbps\": 10.0, \"relative\": 1.0}}}");
+        CHECK_THROWS_AS(auto_model_load(model_file), std::runtime_error);
+        auto_model_load("");
+        std::filesystem::remove(model_file);
+    }
+}
+
+TEST_CASE("Testing built-in PNG decoder")
+{
+    // Dropping alpha cuts the channel off, adding it makes pixels opaque, as stb_image does
+    auto check_decode = [](const std::string &png, const std::vector<unsigned char> &pixels, int channels,
+                           int desired) {
+        const int out = desired ? desired : channels;
+        std::vector<unsigned char> expected;
+        for (size_t i = 0; i < pixels.size(); i += channels)
+        {
+            expected.insert(expected.end(), pixels.begin() + i, pixels.begin() + i + std::min(channels, out));
+            if (out > channels)
+                expected.push_back(255);
+        }
+        int w = 0, h = 0, c = 0;
+        unsigned char *decoded =
+            png_decode(reinterpret_cast<const unsigned char *>(png.data()), png.size(), &w, &h, &c, desired);
+        REQUIRE(decoded != nullptr);
+        CHECK(c == channels);
+        CHECK(static_cast<size_t>(w) * h * out == expected.size());
+        CHECK(std::equal(expected.begin(), expected.end(), decoded));
+        stbi_image_free(decoded);
+    };
+    auto append_be32 = [](std::string &out, uint32_t value) {
+        char bytes[4];
+        put_be32(bytes, value);
+        out.append(bytes, 4);
+    };
+    auto chunk = [&](std::string &png, const char *type, const std::string &body) {
+        std::string tagged = std::string(type, 4) + body;
+        append_be32(png, static_cast<uint32_t>(body.size()));
+        png += tagged;
+        append_be32(png, crc32(tagged.data(), tagged.size()));
+    };
+
+    SUBCASE("Encoder output decodes for every channel request")
+    {
+        const int width = 37, height = 23;
+        for (int channels : {3, 4})
+        {
+            std::vector<unsigned char> noise(static_cast<size_t>(width) * height * channels);
+            std::vector<unsigned char> gradient(noise.size());
+            for (size_t i = 0; i < noise.size(); ++i)
+            {
+                noise[i] = static_cast<unsigned char>((i * 2654435761u) >> 13);
+                gradient[i] = static_cast<unsigned char>(i / channels % width * 5 + i % channels * 40);
+            }
+            for (const auto *pixels : {&noise, &gradient})
+            {
+                const std::string image = "test_png_decode.png";
+                REQUIRE(write_image(image, width, height, channels, pixels->data()));
+                const std::string png = read_file_to_string(image);
+                for (int desired : {0, 3, 4})
+                    check_decode(png, *pixels, channels, desired);
+
+                int w, h, c;
+                unsigned char *loaded = load_image(image, &w, &h, &c, 0);
+                REQUIRE(loaded != nullptr);
+                CHECK(std::equal(pixels->begin(), pixels->end(), loaded));
+                stbi_image_free(loaded);
+                std::filesystem::remove(image);
+            }
+        }
+    }
+
+    SUBCASE("Every filter type on stored blocks")
+    {
+        const int width = 9, height = 10;
+        for (int bpp : {3, 4})
+        {
+            const size_t stride = static_cast<size_t>(width) * bpp;
+            std::vector<unsigned char> pixels(stride * height);
+            for (size_t i = 0; i < pixels.size(); ++i)
+                pixels[i] = static_cast<unsigned char>(i * 97 % 251 + i / stride * 3);
+
+            // Rows cycle through None, Sub, Up, Average and Paeth twice
+            std::string raw;
+            for (int y = 0; y < height; ++y)
+            {
+                const int filter = y % 5;
+                raw += static_cast<char>(filter);
+                for (size_t x = 0; x < stride; ++x)
+                {
+                    const int a = x >= static_cast<size_t>(bpp) ? pixels[y * stride + x - bpp] : 0;
+                    const int b = y ? pixels[(y - 1) * stride + x] : 0;
+                    const int c = y && x >= static_cast<size_t>(bpp) ? pixels[(y - 1) * stride + x - bpp] : 0;
+                    const int p = a + b - c;
+                    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    const int predictors[5] = {0, a, b, (a + b) / 2, pa <= pb && pa <= pc ? a : pb <= pc ? b : c};
+                    raw += static_cast<char>(pixels[y * stride + x] - predictors[filter]);
+                }
+            }
+
+            // Two stored blocks, the second one final, split mid-row
+            std::string zlib("\x78\x01", 2);
+            const size_t split = raw.size() / 3;
+            for (size_t start : {size_t(0), split})
+            {
+                const size_t length = start ? raw.size() - split : split;
+                zlib += static_cast<char>(start ? 1 : 0);
+                zlib += static_cast<char>(length & 0xFF);
+                zlib += static_cast<char>(length >> 8);
+                zlib += static_cast<char>(~length & 0xFF);
+                zlib += static_cast<char>(~length >> 8 & 0xFF);
+                zlib += raw.substr(start, length);
+            }
+            uint32_t s1 = 1, s2 = 0;
+            for (unsigned char v : raw)
+            {
+                s1 = (s1 + v) % 65521;
+                s2 = (s2 + s1) % 65521;
+            }
+            append_be32(zlib, s2 << 16 | s1);
+
+            std::string ihdr;
+            append_be32(ihdr, width);
+            append_be32(ihdr, height);
+            ihdr += std::string("\x08", 1) + static_cast<char>(bpp == 4 ? 6 : 2) + std::string(3, '\0');
+            std::string png("\x89PNG\r\n\x1a\n", 8);
+            chunk(png, "IHDR", ihdr);
+            // Split IDAT chunks are joined before inflating
+            chunk(png, "IDAT", zlib.substr(0, 5));
+            chunk(png, "IDAT", zlib.substr(5));
+            chunk(png, "IEND", "");
+
+            check_decode(png, pixels, bpp, 0);
+            check_decode(png, pixels, bpp, 7 - bpp);
+        }
+    }
+
+    SUBCASE("Unsupported and damaged files are left to stb_image")
+    {
+        const std::string image = "test_png_gray.png";
+        create_test_image(image, 6, 5, 1);
+        const std::string gray = read_file_to_string(image);
+        int w, h, c;
+        CHECK(png_decode(reinterpret_cast<const unsigned char *>(gray.data()), gray.size(), &w, &h, &c, 0) ==
+              nullptr);
+        unsigned char *loaded = load_image(image, &w, &h, &c, 0);
+        REQUIRE(loaded != nullptr);
+        CHECK(c == 1);
+        CHECK(loaded[0] == 128);
+        stbi_image_free(loaded);
+        std::filesystem::remove(image);
+
+        std::vector<unsigned char> pixels(20 * 20 * 3, 77);
+        REQUIRE(write_image(image, 20, 20, 3, pixels.data()));
+        const std::string png = read_file_to_string(image);
+        std::filesystem::remove(image);
+        for (size_t cut : {size_t(4), size_t(30), png.size() / 2, png.size() - 20})
+        {
+            CHECK(png_decode(reinterpret_cast<const unsigned char *>(png.data()), cut, &w, &h, &c, 0) == nullptr);
+        }
+        std::string corrupt = png;
+        corrupt[png.find("IDAT") + 4] = static_cast<char>(0xFF);
+        CHECK(png_decode(reinterpret_cast<const unsigned char *>(corrupt.data()), corrupt.size(), &w, &h, &c, 0) ==
+              nullptr);
+    }
+
+    SUBCASE("Dimensions the IDAT cannot inflate to are rejected")
+    {
+        // 20000 x 20000 RGB needs 1.2 GB of scanlines, a 20-byte stream inflates to at most 20 KB
+        std::string ihdr;
+        append_be32(ihdr, 20000);
+        append_be32(ihdr, 20000);
+        ihdr += std::string("\x08\x02", 2) + std::string(3, '\0');
+        std::string png("\x89PNG\r\n\x1a\n", 8);
+        chunk(png, "IHDR", ihdr);
+        chunk(png, "IDAT", std::string("\x78\x01\x01\x00\x00\xFF\xFF", 7) + std::string(13, '\0'));
+        chunk(png, "IEND", "");
+        int w, h, c;
+        CHECK(png_decode(reinterpret_cast<const unsigned char *>(png.data()), png.size(), &w, &h, &c, 0) == nullptr);
+
+        // A flat carrier compresses close to the bound and still decodes
+        const std::string image = "test_png_flat.png";
+        const std::vector<unsigned char> flat(1000 * 1000 * 3, 0);
+        REQUIRE(write_image(image, 1000, 1000, 3, flat.data()));
+        check_decode(read_file_to_string(image), flat, 3, 0);
+        std::filesystem::remove(image);
+    }
+}
+
+TEST_CASE("Testing sharded payloads")
+{
+    const std::string dir = "test_shards";
+    const std::string index_file = dir + "/index.txt";
+    const std::vector<std::string> carriers = {"test_shard_a.png", "test_shard_b.png"};
+    for (const auto &carrier : carriers)
+        create_test_image(carrier, 12, 12, 3);
+    std::string message;
+    for (int i = 0; i < 60; ++i)
+        message += static_cast<char>('a' + i % 26);
+    create_test_file("test_shard_msg.txt", message);
+
+    shard_embed("mbc", "test_shard_msg.txt", carriers, dir, index_file);
+    shard_extract(index_file, "test_shard_out.txt");
+    CHECK(read_file_to_string("test_shard_out.txt") == message);
+
+    // MBC carries 36 bytes per 12x12 carrier, so the message needs both; lines after the header are shards
+    const std::string index = read_file_to_string(index_file);
+    std::vector<std::string> lines;
+    std::istringstream in(index);
+    for (std::string line; std::getline(in, line);)
+        lines.push_back(line);
+    REQUIRE(lines.size() == 3);
+    auto rewrite = [&](const std::string &header, const std::string &first, const std::string &second) {
+        create_test_file(index_file, header + "\n" + first + "\n" + second + "\n");
+    };
+
+    SUBCASE("Missing shard is a gap")
+    {
+        const std::string header = lines[0].substr(0, lines[0].rfind(' ')) + " 1";
+        rewrite(header, lines[2], "");
+        CHECK_THROWS_AS(shard_extract(index_file, "test_shard_out.txt"), std::runtime_error);
+        rewrite(header, lines[1], "");
+        CHECK_THROWS_AS(shard_extract(index_file, "test_shard_out.txt"), std::runtime_error);
+    }
+
+    SUBCASE("Shard count beyond the listed lines is rejected")
+    {
+        const std::string header = lines[0].substr(0, lines[0].rfind(' ')) + " 1000000000000";
+        rewrite(header, lines[1], lines[2]);
+        CHECK_THROWS_AS(shard_extract(index_file, "test_shard_out.txt"), std::runtime_error);
+    }
+
+    SUBCASE("Overlapping shards are rejected")
+    {
+        rewrite(lines[0], lines[1], lines[1]);
+        CHECK_THROWS_AS(shard_extract(index_file, "test_shard_out.txt"), std::runtime_error);
+    }
+
+    SUBCASE("Shard order in the index does not matter")
+    {
+        rewrite(lines[0], lines[2], lines[1]);
+        shard_extract(index_file, "test_shard_out.txt");
+        CHECK(read_file_to_string("test_shard_out.txt") == message);
+    }
+
+    for (const auto &carrier : carriers)
+        std::filesystem::remove(carrier);
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove("test_shard_msg.txt");
+    std::filesystem::remove("test_shard_out.txt");
+}